@@ -0,0 +1,105 @@
+// PEQ micro-benchmark, saturated link: TLPs back to back into the receiver,
+// every TLP answered by Ack and UpdateFC 10 ns later, same as PCIeDataLinkLayer
+//   usage: ./_peq_bench [stock|wheel] [simulated ms]
+#include <systemc>
+#include <tlm>
+#include <tlm_utils/peq_with_cb_and_phase.h>
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include "pcie_peq.hpp"
+
+#define BenchPayloadPool      4096
+#define BenchMaxPayloadDW     64
+
+template <template <typename> class PEQ>
+class PEQBench
+: sc_core::sc_module
+{
+public:
+    PEQBench(sc_core::sc_module_name name)
+    : sc_core::sc_module(name),
+      m_peq(this, &PEQBench::peq_callback),
+      pool(BenchPayloadPool)
+    {
+        next = 0;
+        seed = 1;
+
+        // profiling
+        tlp_count = 0;
+        dllp_count = 0;
+
+        SC_THREAD(process_link);
+    }
+
+    uint64_t tlp_count;
+    uint64_t dllp_count;
+
+private:
+    PEQ<PEQBench> m_peq;
+    std::vector<tlm::tlm_generic_payload> pool;
+    uint32_t next;
+    uint32_t seed;
+
+    tlm::tlm_generic_payload& alloc() {
+        tlm::tlm_generic_payload& trans = pool[next];
+        next = (next + 1) % BenchPayloadPool;
+        return trans;
+    }
+
+    void process_link() {
+        while (true) {
+            seed = (seed * 1103515245) + 12345;
+            uint32_t length = ((seed >> 16) % BenchMaxPayloadDW) + 1;
+            wait(length * 2, sc_core::SC_NS);
+            m_peq.notify(alloc(), tlm::BEGIN_REQ, sc_core::SC_ZERO_TIME);
+        }
+    }
+
+    void peq_callback(tlm::tlm_generic_payload& trans, const tlm::tlm_phase& phase) {
+        (void)trans;
+        if (phase == tlm::BEGIN_REQ) {
+            tlp_count++;
+            m_peq.notify(alloc(), tlm::BEGIN_RESP, sc_core::sc_time(10, sc_core::SC_NS));    // Ack
+            m_peq.notify(alloc(), tlm::BEGIN_RESP, sc_core::sc_time(10, sc_core::SC_NS));    // UpdateFC
+        }
+        else {
+            dllp_count++;
+        }
+    }
+};
+
+template <typename OWNER>
+using StockPEQ = tlm_utils::peq_with_cb_and_phase<OWNER>;
+
+template <typename OWNER>
+using WheelPEQ = PCIeWheelPEQ<OWNER>;
+
+template <template <typename> class PEQ>
+void run_bench(const char* label, double duration_ms)
+{
+    PEQBench<PEQ> bench("bench");
+
+    auto start = std::chrono::steady_clock::now();
+    sc_core::sc_start(duration_ms, sc_core::SC_MS);
+    auto stop = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    uint64_t events = bench.tlp_count + bench.dllp_count;
+    std::cout << label << ": TLP " << bench.tlp_count << ", DLLP " << bench.dllp_count
+              << ", wall " << seconds << " s, " << (events / seconds) / 1e6 << " M events/s, "
+              << (seconds * 1e9) / events << " ns/event" << std::endl;
+}
+
+int sc_main(int argc, char* argv[]) {
+    const char* type = (argc > 1) ? argv[1] : "wheel";
+    double duration_ms = (argc > 2) ? std::atof(argv[2]) : 10;
+
+    if (std::strcmp(type, "stock") == 0) {
+        run_bench<StockPEQ>("peq_with_cb_and_phase", duration_ms);
+    }
+    else {
+        run_bench<WheelPEQ>("PCIeWheelPEQ", duration_ms);
+    }
+    return 0;
+}
@@ -0,0 +1,178 @@
+#pragma once
+#include <systemc>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <map>
+#include <type_traits>
+
+#define CheckpointMagic       0x504B4350    // "PCKP"
+#define CheckpointVersion     11
+
+// binary checkpoint stream, every component writes a named section so a
+// checkpoint taken with a different model configuration fails loudly
+// sc_time is stored relative to the checkpoint time and clamped at zero on restore
+class CheckpointWriter {
+public:
+    CheckpointWriter(const std::string& path)
+    : file(path, std::ios::binary),
+      base(sc_core::sc_time_stamp())
+    {
+        put<uint32_t>(CheckpointMagic);
+        put<uint32_t>(CheckpointVersion);
+        put<double>(base.to_seconds());
+    }
+
+    bool good() const { return file.good(); }
+
+    template <typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint field must be trivially copyable");
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void put_time(const sc_core::sc_time& time) {
+        put<double>(time.to_seconds() - base.to_seconds());
+    }
+
+    void put_string(const std::string& value) {
+        put<uint32_t>(value.size());
+        file.write(value.data(), value.size());
+    }
+
+    void section(const std::string& name) {
+        put_string(name);
+    }
+
+    template <typename T>
+    void put_vector(const std::vector<T>& values) {
+        put<uint32_t>(values.size());
+        for (const T& value : values) {
+            put(value);
+        }
+    }
+
+    template <typename T>
+    void put_deque(const std::deque<T>& values) {
+        put<uint32_t>(values.size());
+        for (const T& value : values) {
+            put(value);
+        }
+    }
+
+    template <typename T>
+    void put_queue(std::queue<T> values) {
+        put<uint32_t>(values.size());
+        while (!values.empty()) {
+            put(values.front());
+            values.pop();
+        }
+    }
+
+    template <typename K, typename V>
+    void put_map(const std::map<K, V>& values) {
+        put<uint32_t>(values.size());
+        for (const auto& entry : values) {
+            put(entry.first);
+            put(entry.second);
+        }
+    }
+
+private:
+    std::ofstream file;
+    sc_core::sc_time base;
+};
+
+class CheckpointReader {
+public:
+    CheckpointReader(const std::string& path)
+    : file(path, std::ios::binary),
+      base(sc_core::sc_time_stamp()),
+      valid(file.good())
+    {
+        valid = valid && get<uint32_t>() == CheckpointMagic && get<uint32_t>() == CheckpointVersion;
+        saved_time = get<double>();
+    }
+
+    bool good() const { return valid && file.good(); }
+    double get_saved_time() const { return saved_time; }
+
+    template <typename T>
+    T get() {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint field must be trivially copyable");
+        T value{};
+        file.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return value;
+    }
+
+    sc_core::sc_time get_time() {
+        double seconds = base.to_seconds() + get<double>();
+        return (seconds > 0) ? sc_core::sc_time(seconds, sc_core::SC_SEC) : sc_core::SC_ZERO_TIME;
+    }
+
+    std::string get_string() {
+        std::string value(get<uint32_t>(), '\0');
+        file.read(&value[0], value.size());
+        return value;
+    }
+
+    bool section(const std::string& name) {
+        valid = valid && get_string() == name;
+        return valid;
+    }
+
+    template <typename T>
+    void get_vector(std::vector<T>& values) {
+        values.resize(get<uint32_t>());
+        for (T& value : values) {
+            value = get<T>();
+        }
+    }
+
+    // fixed size storage, a checkpoint of another size invalidates the reader
+    template <typename T>
+    bool get_vector(std::vector<T>& values, size_t expected) {
+        valid = valid && get<uint32_t>() == expected && values.size() == expected;
+        if (!valid) {
+            return false;
+        }
+        for (T& value : values) {
+            value = get<T>();
+        }
+        return true;
+    }
+
+    template <typename T>
+    void get_deque(std::deque<T>& values) {
+        values.resize(get<uint32_t>());
+        for (T& value : values) {
+            value = get<T>();
+        }
+    }
+
+    template <typename T>
+    void get_queue(std::queue<T>& values) {
+        values = std::queue<T>();
+        for (uint32_t count = get<uint32_t>(); count > 0; count--) {
+            values.push(get<T>());
+        }
+    }
+
+    template <typename K, typename V>
+    void get_map(std::map<K, V>& values) {
+        values.clear();
+        for (uint32_t count = get<uint32_t>(); count > 0; count--) {
+            K key = get<K>();
+            values[key] = get<V>();
+        }
+    }
+
+private:
+    std::ifstream file;
+    sc_core::sc_time base;
+    bool valid;
+    double saved_time;
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "checkpoint.hpp"
+
+#define HostMemoryPageSize    4096  // byte
+#define HostMSIAddressBase    0xFEE00000
+#define HostMSIAddressSize    0x00100000
+
+// sparse DW-addressable host memory, pages are allocated on first write
+class HostMemory {
+public:
+    uint32_t read_dw(uint64_t address) const {
+        auto it = pages.find(address / HostMemoryPageSize);
+        if (it == pages.end()) {
+            return 0;
+        }
+        return it->second[(address % HostMemoryPageSize) / 4];
+    }
+
+    void write_dw(uint64_t address, uint32_t data) {
+        get_page(address)[(address % HostMemoryPageSize) / 4] = data;
+    }
+
+    // backing storage of the page holding address, used for DMI
+    uint32_t* get_page(uint64_t address) {
+        std::vector<uint32_t>& page = pages[address / HostMemoryPageSize];
+        if (page.empty()) {
+            page.resize(HostMemoryPageSize / 4, 0);
+        }
+        return page.data();
+    }
+
+    void save(CheckpointWriter& writer) const {
+        writer.section("host_memory");
+        writer.put<uint64_t>(pages.size());
+        for (const auto& page : pages) {
+            writer.put(page.first);
+            writer.put_vector(page.second);
+        }
+    }
+
+    bool restore(CheckpointReader& reader) {
+        if (!reader.section("host_memory")) {
+            return false;
+        }
+        pages.clear();
+        for (uint64_t count = reader.get<uint64_t>(); count > 0; count--) {
+            uint64_t page = reader.get<uint64_t>();
+            reader.get_vector(pages[page]);
+        }
+        return reader.good();
+    }
+
+private:
+    std::unordered_map<uint64_t, std::vector<uint32_t>> pages;
+};
@@ -0,0 +1,145 @@
+#pragma once
+#include <systemc>
+#include <tlm>
+#include <set>
+#include <vector>
+#include <functional>
+#include "log.hpp"
+#include "host_memory.hpp"
+#include "checkpoint.hpp"
+
+using namespace sc_core;
+
+#define MemoryBackendFixed    0     // constant latency and bandwidth
+#define MemoryBackendDRAM     1     // bank / row buffer timing, open-page policy
+#ifndef CompleterMemoryBackend
+#define CompleterMemoryBackend  MemoryBackendDRAM
+#endif
+#define MemoryQueueDepth      32    // requests accepted by memory controller before it pushes back
+
+// fixed latency model
+#define MemoryFixedLatency    60    // ns
+#define MemoryFixedBandwidth  16    // byte/ns
+
+// DRAM timing model, address = row | bank | channel | column
+#define DRAMChannels          2
+#define DRAMBanks             16
+#define DRAMRowSize           2048  // byte
+#define DRAMBurstSize         64    // byte
+#define DRAMtRCD              14    // ns, activate to read/write
+#define DRAMtCL               14    // ns, read/write to data
+#define DRAMtRP               14    // ns, precharge
+#define DRAMtBurst            4     // ns, one burst on the data bus
+
+struct MemoryAccess {
+    sc_core::sc_time accept_time;   // request taken by the controller, receive buffer may be freed
+    sc_core::sc_time done_time;     // write absorbed or read data available
+};
+
+// timing only, data is kept functionally in HostMemory
+class MemoryBackend
+: public sc_core::sc_module
+{
+public:
+    MemoryBackend(sc_core::sc_module_name name, HostMemory *m_hostMemory_)
+    : sc_core::sc_module(name),
+      m_hostMemory(m_hostMemory_),
+      functional(false)
+    {
+        // profiling
+        profile_read_count = 0;
+        profile_write_count = 0;
+        profile_byte_size = 0;
+        profile_latency = 0;
+        profile_stall = 0;
+    }
+
+    //  ====================================
+    //  public function can be used by other
+    //  ====================================
+    MemoryAccess access(uint64_t address, uint32_t length, bool write, sc_core::sc_time start);
+    bool get_direct_mem_ptr(uint64_t address, tlm::tlm_dmi& dmi_data);
+    void set_functional(bool enable) { functional = enable; }
+    bool is_functional() { return functional; }
+    virtual void report_stats();
+    virtual void save(CheckpointWriter& writer);
+    virtual bool restore(CheckpointReader& reader);
+
+protected:
+
+    // -- component
+    HostMemory *m_hostMemory;
+    std::multiset<sc_core::sc_time> outstanding;    // done times of accepted requests
+    bool functional;    // sampling fast-forward, unloaded latency, timing state left alone
+
+    // -- function
+    virtual sc_core::sc_time service(uint64_t address, uint32_t length, bool write, sc_core::sc_time start) = 0;
+
+    // -- profile
+    uint64_t profile_read_count;
+    uint64_t profile_write_count;
+    double profile_byte_size;
+    double profile_latency;
+    double profile_stall;
+
+};
+
+class FixedLatencyMemory
+: public MemoryBackend
+{
+public:
+    FixedLatencyMemory(sc_core::sc_module_name name, HostMemory *m_hostMemory_)
+    : MemoryBackend(name, m_hostMemory_),
+      busFree(SC_ZERO_TIME)
+    {
+        SC_LOG(INFO, "init done: latency=%d ns, bandwidth=%d B/ns", MemoryFixedLatency, MemoryFixedBandwidth);
+    }
+
+    void save(CheckpointWriter& writer) override;
+    bool restore(CheckpointReader& reader) override;
+
+private:
+    sc_core::sc_time busFree;
+
+    sc_core::sc_time service(uint64_t address, uint32_t length, bool write, sc_core::sc_time start) override;
+};
+
+class DRAMMemory
+: public MemoryBackend
+{
+public:
+    DRAMMemory(sc_core::sc_module_name name, HostMemory *m_hostMemory_)
+    : MemoryBackend(name, m_hostMemory_)
+    {
+        banks.resize(DRAMChannels * DRAMBanks);
+        busFree.resize(DRAMChannels, SC_ZERO_TIME);
+
+        // profiling
+        profile_row_hit = 0;
+        profile_row_miss = 0;
+        profile_row_conflict = 0;
+
+        SC_LOG(INFO, "init done: channel=%d, bank=%d, row=%d B", DRAMChannels, DRAMBanks, DRAMRowSize);
+    }
+
+    void report_stats() override;
+    void save(CheckpointWriter& writer) override;
+    bool restore(CheckpointReader& reader) override;
+
+private:
+    struct Bank {
+        bool open = false;
+        uint64_t row = 0;
+        sc_core::sc_time ready = SC_ZERO_TIME;
+    };
+
+    std::vector<Bank> banks;
+    std::vector<sc_core::sc_time> busFree;
+
+    sc_core::sc_time service(uint64_t address, uint32_t length, bool write, sc_core::sc_time start) override;
+
+    // -- profile
+    uint64_t profile_row_hit;
+    uint64_t profile_row_miss;
+    uint64_t profile_row_conflict;
+};
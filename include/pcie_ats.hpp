@@ -0,0 +1,214 @@
+#pragma once
+#include <systemc>
+#include <queue>
+#include <map>
+#include <functional>
+#include "log.hpp"
+#include "pcie_layers.hpp"
+#include "checkpoint.hpp"
+
+using namespace sc_core;
+
+#define ATSPageSize           4096  // byte
+#ifndef ATSEnable
+#define ATSEnable             0     // device caches translations and sends translated requests
+#endif
+#define ATCEntries            64
+#define ATCWays               4
+#ifndef IOMMUEnable
+#define IOMMUEnable           0     // root complex translates every untranslated request
+#endif
+#define IOMMUIOTLBEntries     256
+#define IOMMUIOTLBWays        8
+#define IOMMUIOTLBLatency     5     // ns
+#define IOMMUPageWalkLevels   4
+#define IOMMUPageWalkLatency  80    // ns, per level
+#ifndef IOMMUStrictInvalidate
+#define IOMMUStrictInvalidate 0     // driver unmaps every buffer on DMA completion
+#endif
+
+// set-associative translation cache with LRU replacement, keyed by page number
+class TranslationCache {
+public:
+    TranslationCache(uint32_t entries, uint32_t ways)
+    : setCount(entries / ways), wayCount(ways), lruClock(0)
+    {
+        cache.resize(setCount * wayCount);
+    }
+
+    bool lookup(uint64_t page, uint64_t& translated) {
+        Entry *set = &cache[(page % setCount) * wayCount];
+        for (uint32_t way = 0; way < wayCount; way++) {
+            if (set[way].valid && set[way].page == page) {
+                set[way].lru = ++lruClock;
+                translated = set[way].translated;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void insert(uint64_t page, uint64_t translated) {
+        Entry *set = &cache[(page % setCount) * wayCount];
+        Entry *victim = &set[0];
+        for (uint32_t way = 0; way < wayCount; way++) {
+            if (!set[way].valid || set[way].page == page) {
+                victim = &set[way];
+                break;
+            }
+            if (set[way].lru < victim->lru) {
+                victim = &set[way];
+            }
+        }
+        victim->valid = true;
+        victim->page = page;
+        victim->translated = translated;
+        victim->lru = ++lruClock;
+    }
+
+    bool invalidate(uint64_t page) {
+        Entry *set = &cache[(page % setCount) * wayCount];
+        for (uint32_t way = 0; way < wayCount; way++) {
+            if (set[way].valid && set[way].page == page) {
+                set[way].valid = false;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void save(CheckpointWriter& writer) const {
+        writer.put(lruClock);
+        writer.put_vector(cache);
+    }
+
+    void restore(CheckpointReader& reader) {
+        lruClock = reader.get<uint64_t>();
+        reader.get_vector(cache);
+    }
+
+private:
+    struct Entry {
+        bool valid = false;
+        uint64_t page = 0;
+        uint64_t translated = 0;
+        uint64_t lru = 0;
+    };
+
+    uint32_t setCount, wayCount;
+    uint64_t lruClock;
+    std::vector<Entry> cache;
+};
+
+// root complex IOMMU, IOVA is mapped 1:1 so only the translation cost is modelled
+class PCIeIOMMU
+: sc_core::sc_module
+{
+public:
+    PCIeIOMMU(sc_core::sc_module_name name)
+    : sc_core::sc_module(name),
+      iotlb(IOMMUIOTLBEntries, IOMMUIOTLBWays)
+    {
+        invalidateTag = 0;
+
+        // profiling
+        profile_lookup_count = 0;
+        profile_hit_count = 0;
+        profile_walk_count = 0;
+        profile_latency = 0;
+        profile_invalidate_count = 0;
+        profile_invalidate_pending = 0;
+
+        SC_LOG(INFO, "init done");
+    }
+
+    //  ====================================
+    //  public function can be used by other
+    //  ====================================
+    sc_core::sc_time translate(uint64_t address, uint8_t at, uint64_t& translated);
+    void unmap(uint64_t address, uint32_t length);
+    void complete_invalidation(uint32_t itag);
+    void register_invalidate(std::function<void(uint64_t, uint32_t)> handler);
+    void report_stats();
+    void save(CheckpointWriter& writer);
+    bool restore(CheckpointReader& reader);
+
+private:
+
+    // -- component
+    TranslationCache iotlb;
+    uint32_t invalidateTag;
+    std::function<void(uint64_t, uint32_t)> invalidate_handler;
+
+    // -- profile
+    uint64_t profile_lookup_count;
+    uint64_t profile_hit_count;
+    uint64_t profile_walk_count;
+    double profile_latency;
+    uint64_t profile_invalidate_count;
+    uint64_t profile_invalidate_pending;
+
+};
+
+enum class ATCLookup {
+    Hit,
+    Miss,       // Translation Request outstanding, the translation handler runs on its completion
+    Retry,      // Translation Request refused, nothing outstanding, look up again later
+};
+
+struct ATC_pending {
+    sc_core::sc_time start;     // Translation Request sent
+    uint32_t waiters;           // requests parked on the page
+};
+
+// device side address translation cache, a miss parks only the request that missed
+class PCIeATC
+: sc_core::sc_module
+{
+public:
+    PCIeATC(sc_core::sc_module_name name, PCIeTransactionLayer *m_transactionLayer_)
+    : sc_core::sc_module(name),
+      m_transactionLayer(m_transactionLayer_),
+      atc(ATCEntries, ATCWays)
+    {
+        // profiling
+        profile_lookup_count = 0;
+        profile_hit_count = 0;
+        profile_request_count = 0;
+        profile_invalidate_count = 0;
+        profile_latency = 0;
+
+        SC_THREAD(process_invalidation);
+        SC_LOG(INFO, "init done");
+    }
+
+    //  ====================================
+    //  public function can be used by other
+    //  ====================================
+    ATCLookup lookup(uint64_t address, uint64_t& translated, bool retry = false);
+    void register_translation(std::function<void()> handler);
+    void receive_translation(const PCIeTLPHeader& header, std::vector<PCIeTLPPayload>* payloads);
+    void receive_invalidation(std::vector<PCIeTLPPayload>* payloads);
+    void report_stats();
+
+private:
+
+    // -- component
+    PCIeTransactionLayer *m_transactionLayer;
+    TranslationCache atc;
+    std::map<uint64_t, ATC_pending> pendingPage;
+    std::function<void()> translation_handler;
+    std::queue<uint32_t> invalidation_queue;
+    sc_core::sc_event event_invalidation;
+
+    // -- function
+    void process_invalidation();
+
+    // -- profile
+    uint64_t profile_lookup_count;
+    uint64_t profile_hit_count;
+    uint64_t profile_request_count;
+    uint64_t profile_invalidate_count;
+    double profile_latency;
+
+};
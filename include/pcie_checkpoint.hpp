@@ -0,0 +1,50 @@
+#pragma once
+#include <systemc>
+#include <string>
+#include "log.hpp"
+#include "checkpoint.hpp"
+#include "pcie_requester.hpp"
+#include "pcie_completer.hpp"
+
+using namespace sc_core;
+
+#define CheckpointDrainPoll   10    // ns, link idle check while draining
+
+// takes a checkpoint mid-run and restores one into a fresh process
+//   save: pause both DLL transmitters, wait until nothing is left on the link, write state, resume
+//   restore: called after elaboration and before sc_start
+// only the random traffic generator keeps all of its state in members
+class PCIeCheckpointController
+: sc_core::sc_module
+{
+public:
+    PCIeCheckpointController(sc_core::sc_module_name name, PCIeRequester_ *m_requester_, PCIeCompleter_ *m_completer_)
+    : sc_core::sc_module(name),
+      m_requester(m_requester_),
+      m_completer(m_completer_)
+    {
+        SC_THREAD(process_save);
+        SC_LOG(INFO, "init done");
+    }
+
+    //  ====================================
+    //  public function can be used by other
+    //  ====================================
+    void schedule_save(const std::string& path, sc_core::sc_time time);
+    bool save(const std::string& path);
+    bool restore(const std::string& path);
+
+private:
+
+    // -- component
+    PCIeRequester_ *m_requester;
+    PCIeCompleter_ *m_completer;
+    std::string savePath;
+    sc_core::sc_time saveTime;
+
+    // -- function
+    void process_save();
+    void save_config(CheckpointWriter& writer);
+    bool restore_config(CheckpointReader& reader);
+
+};
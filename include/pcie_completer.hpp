@@ -1,9 +1,32 @@
 #pragma once
+#include <queue>
+#include <map>
+#include <cstring>
 #include "log.hpp"
+#include "host_memory.hpp"
 #include "pcie_layers.hpp"
+#include "pcie_ats.hpp"
+#include "memory_backend.hpp"
 
 using namespace sc_core;
 
+struct Completer_request {
+    PCIeTLPHeader header;
+    uint64_t address;
+    sc_core::sc_time ready_time;    // after IOMMU translation
+};
+
+// posted write data, lands in host memory once translated and absorbed by memory
+struct Completer_write {
+    uint64_t address;
+    std::vector<uint32_t> data;
+};
+
+struct Completer_invalidation {
+    uint64_t address;
+    uint32_t itag;
+};
+
 class PCIeCompleter_
 : sc_core::sc_module
 {
@@ -14,8 +37,39 @@ public:
     {
         m_dataLinkLayer = new PCIeDataLinkLayer("dataLinkLayer", completerID);
         m_transactionLayer = new PCIeTransactionLayer("transactionLayer", completerID, m_dataLinkLayer);
+        m_dataLinkLayer->m_transactionLayer = m_transactionLayer;
+        m_transactionLayer->register_receive_TLP([this](const PCIeTLPHeader& header, std::vector<PCIeTLPPayload>* payloads) {
+            return receive_TLP(header, payloads);
+        });
+        m_dataLinkLayer->register_direct_mem_ptr([this](uint64_t address, tlm::tlm_dmi& dmi_data) {
+            return get_direct_mem_ptr(address, dmi_data);
+        });
+        m_dataLinkLayer->register_transport_dbg([this](uint64_t address, unsigned char* data, unsigned int length, bool write) {
+            return transport_dbg(address, data, length, write);
+        });
+        lastWriteVisible = SC_ZERO_TIME;
+
+        m_hostMemory = new HostMemory();
+#if CompleterMemoryBackend == MemoryBackendDRAM
+        m_memory = new DRAMMemory("memory", m_hostMemory);
+#else
+        m_memory = new FixedLatencyMemory("memory", m_hostMemory);
+#endif
+        dmiValid = false;
+        m_iommu = new PCIeIOMMU("iommu");
+        m_iommu->register_invalidate([this](uint64_t address, uint32_t itag) {
+            invalidation_queue.push({address, itag});
+            event_invalidation_queue.notify();
+        });
+
+        // profiling
+        profile_msix_count = 0;
+        profile_access_count = 0;
 
         // SC_THREAD(process_send_command);
+        SC_THREAD(process_completion);
+        SC_THREAD(process_invalidation);
+        SC_THREAD(process_write);
         SC_LOG(INFO, "init done");
     }
 
@@ -26,14 +80,41 @@ public:
     //  public function can be used by other
     //  ====================================
     // void process_send_command();
+    sc_core::sc_time receive_TLP(const PCIeTLPHeader& header, std::vector<PCIeTLPPayload>* payloads);
+    void save(CheckpointWriter& writer);
+    bool restore(CheckpointReader& reader);
+    bool writes_drained() { return write_queue.empty(); }
 
     PCIeTransactionLayer *m_transactionLayer;
     PCIeDataLinkLayer *m_dataLinkLayer;
+    HostMemory *m_hostMemory;
+    MemoryBackend *m_memory;
+    PCIeIOMMU *m_iommu;
 
 private:
 
-
+    // -- component
+    std::queue<Completer_request> request_queue;
+    sc_core::sc_event event_request_queue;
+    std::queue<Completer_invalidation> invalidation_queue;
+    sc_core::sc_event event_invalidation_queue;
+    std::multimap<sc_core::sc_time, Completer_write> write_queue;   // by visible time
+    sc_core::sc_event event_write_queue;
+    sc_core::sc_time lastWriteVisible;      // latest of every posted write, relaxed ones too; strict writes and reads wait for it
+    tlm::tlm_dmi dmi;                       // host memory page for fast-forward writes
+    bool dmiValid;
 
     // -- function
+    void process_completion();
+    void process_invalidation();
+    void process_write();
+    bool may_pass_writes(const PCIeTLPHeader& header);
+    bool write_direct(uint64_t address, std::vector<PCIeTLPPayload>* payloads);
+    bool get_direct_mem_ptr(uint64_t address, tlm::tlm_dmi& dmi_data);
+    unsigned int transport_dbg(uint64_t address, unsigned char* data, unsigned int length, bool write);
+
+    // -- profile
+    uint64_t profile_msix_count;
+    uint64_t profile_access_count;
 
-};
\ No newline at end of file
+};
@@ -0,0 +1,240 @@
+#pragma once
+#include <systemc>
+#include <queue>
+#include <deque>
+#include <map>
+#include "log.hpp"
+#include "utils.hpp"
+#include "host_memory.hpp"
+#include "pcie_layers.hpp"
+#include "pcie_ats.hpp"
+
+using namespace sc_core;
+
+#define DMARingEntries        256
+#define DMADescriptorDW       4
+#define DMACompletionDW       4
+#define DMAMaxInflightDesc    8
+#define DMADescFetchBatch     4
+#define DMAMSIXEnable         1
+#define DMARelaxedOrdering    1     // data TLPs set RO, completion entry and MSI-X stay strictly ordered
+#ifndef DMAIDOrdering
+#define DMAIDOrdering         1     // every TLP sets IDO, it may pass only TLPs of another ring or the write generator
+#endif
+#define DMAFunctionBase       1     // ring r issues as function DMAFunctionBase + r, function 0 is the write generator
+
+// descriptor control bits
+#define DMADescCtrlWrite      0x1   // device to host, otherwise host to device
+#define DMADescCtrlIRQ        0x2
+#define DMADescCtrlTCShift    2     // control[4:2] traffic class
+
+// host driver workload
+#define DMAHostMinLength      512   // byte
+#define DMAHostMaxLength      16384 // byte
+#define DMAHostBufferBase     0x100000000ULL
+#define DMAHostPollInterval   100   // ns
+
+// descriptor layout in host memory (4 DW)
+//   DW0: address[31:0], DW1: address[63:32], DW2: length (byte), DW3: id[15:0] | control[31:16]
+struct DMADescriptor {
+    uint64_t address;
+    uint32_t length;
+    uint16_t id;
+    uint16_t control;
+};
+
+// completion entry layout in host memory (4 DW)
+//   DW0: id, DW1: length (byte), DW2: sq_head, DW3: phase
+struct DMARing {
+    uint64_t sq_base;
+    uint64_t cq_base;
+    uint32_t entries;
+    uint32_t sq_head;       // next descriptor to fetch
+    uint32_t sq_tail;       // written by doorbell
+    uint32_t cq_tail;
+    uint32_t cq_phase;
+    bool     fetching;
+    uint64_t msix_address;
+    uint32_t msix_data;
+};
+
+struct DMA_transaction {
+    DMADescriptor desc;
+    uint32_t ring;
+    uint32_t issued;        // byte already segmented
+    uint32_t received;      // byte of read data returned
+    bool translating;       // parked on an ATC miss
+    sc_core::sc_time start_time;
+};
+
+enum class DMAReadType {
+    Descriptor,
+    Data,
+};
+
+struct DMA_read {
+    DMAReadType type;
+    uint64_t address;
+    uint32_t ring;          // issuing ring
+    uint32_t count;         // descriptor fetch
+    uint32_t slot;          // data read
+    uint32_t length;        // byte
+    uint32_t received;      // byte
+    std::vector<uint32_t> data;
+};
+
+class PCIeDMAEngine
+: sc_core::sc_module
+{
+public:
+    PCIeDMAEngine(sc_core::sc_module_name name, unsigned int id, PCIeTransactionLayer *m_transactionLayer_, PCIeATC *m_atc_)
+    : sc_core::sc_module(name),
+      engineID(id),
+      m_transactionLayer(m_transactionLayer_),
+      m_atc(m_atc_)
+    {
+        inflight.resize(DMAMaxInflightDesc);
+        inflight_valid.resize(DMAMaxInflightDesc, false);
+        for (uint32_t i = 0; i < DMAMaxInflightDesc; i++) {
+            freeSlot.push(i);
+        }
+        fetchingCount = 0;
+        fetchRing = 0;
+        nextReadID = 0;
+        translationReady = false;
+        m_atc->register_translation([this]() {
+            translationReady = true;
+            event_segment.notify();
+        });
+
+        // profiling
+        profile_desc_count = 0;
+        profile_byte_size = 0;
+        profile_tlp_count = 0;
+        profile_msix_count = 0;
+        profile_latency = 0;
+
+        SC_THREAD(process_fetch_descriptor);
+        SC_THREAD(process_segment);
+        SC_THREAD(process_completion);
+        SC_LOG(INFO, "init done");
+    }
+
+    // General Component
+    unsigned int engineID;
+
+    //  ====================================
+    //  public function can be used by other
+    //  ====================================
+    uint32_t add_ring(uint64_t sq_base, uint64_t cq_base, uint32_t entries, uint64_t msix_address, uint32_t msix_data);
+    void ring_doorbell(uint32_t ring, uint32_t sq_tail);
+    void receive_completion(const PCIeTLPHeader& header, std::vector<PCIeTLPPayload>* payloads);
+
+private:
+
+    // -- component
+    PCIeTransactionLayer *m_transactionLayer;
+    PCIeATC *m_atc;
+    std::vector<DMARing> rings;
+    std::vector<DMA_transaction> inflight;
+    std::vector<bool> inflight_valid;
+    std::queue<uint32_t> freeSlot;
+    std::queue<uint32_t> segmentQueue;      // slot waiting to be segmented
+    std::queue<uint32_t> translationQueue;  // slot waiting for an ATC fill
+    bool translationReady;
+    std::queue<uint32_t> completionQueue;   // slot waiting for completion entry
+    std::map<uint32_t, DMA_read> outstandingRead;  // read id, carried as the TL tag context
+    uint32_t nextReadID;
+    uint32_t fetchingCount;
+    uint32_t fetchRing;
+    sc_core::sc_event event_doorbell;
+    sc_core::sc_event event_segment;
+    sc_core::sc_event event_completion;
+
+    // -- function
+    void process_fetch_descriptor();
+    void process_segment();
+    void process_completion();
+    bool issue_segment(uint32_t slot);
+    void complete_read(DMA_read& read);
+    void issue_read(DMA_read& read, uint8_t tc = 0, uint8_t attr = 0, uint8_t at = PCIeATUntranslated);
+    void send_write(uint32_t ring, uint64_t address, std::vector<PCIeTLPPayload>* payloads, uint8_t tc = 0, uint8_t attr = 0, uint8_t at = PCIeATUntranslated);
+    uint8_t ring_function(uint32_t ring) { return (DMAFunctionBase + ring) & 0x7; }
+
+    // -- profile
+    uint64_t profile_desc_count;
+    double profile_byte_size;
+    uint64_t profile_tlp_count;
+    uint64_t profile_msix_count;
+    double profile_latency;
+
+};
+
+// host side software posting descriptors and reaping completion entries
+class DMAHostDriver
+: sc_core::sc_module
+{
+public:
+    DMAHostDriver(sc_core::sc_module_name name, HostMemory *m_hostMemory_, PCIeDMAEngine *m_dmaEngine_, uint64_t ring_base, uint8_t tc = 0)
+    : sc_core::sc_module(name),
+      m_hostMemory(m_hostMemory_),
+      m_dmaEngine(m_dmaEngine_),
+      m_iommu(nullptr),
+      rand(DMAHostMinLength / 4, DMAHostMaxLength / 4),
+      trafficClass(tc)
+    {
+        ring.sq_base = ring_base;
+        ring.cq_base = ring_base + (DMARingEntries * DMADescriptorDW * 4);
+        ring.entries = DMARingEntries;
+        ring.sq_head = 0;
+        ring.sq_tail = 0;
+        ring.cq_tail = 0;   // driver's cq head
+        ring.cq_phase = 1;
+        ring.fetching = false;
+        ring.msix_address = HostMSIAddressBase;
+        ring.msix_data = 0;
+        ringID = m_dmaEngine->add_ring(ring.sq_base, ring.cq_base, ring.entries, ring.msix_address, ring.msix_data);
+        submit_time.resize(DMARingEntries);
+        submit_desc.resize(DMARingEntries);
+        busy.resize(DMARingEntries, false);
+        start_time = sc_core::sc_time_stamp();
+
+        // profiling
+        profile_desc_count = 0;
+        profile_byte_size = 0;
+        profile_latency = 0;
+
+        SC_THREAD(process_submit);
+        SC_LOG(INFO, "init done");
+    }
+
+    //  ====================================
+    //  public function can be used by other
+    //  ====================================
+    void set_iommu(PCIeIOMMU *iommu);
+
+private:
+
+    // -- component
+    HostMemory *m_hostMemory;
+    PCIeDMAEngine *m_dmaEngine;
+    PCIeIOMMU *m_iommu;
+    Randomizer rand;
+    uint8_t trafficClass;
+    DMARing ring;
+    uint32_t ringID;
+    std::vector<sc_core::sc_time> submit_time;
+    std::vector<DMADescriptor> submit_desc;
+    std::vector<bool> busy;
+    sc_core::sc_time start_time;
+
+    // -- function
+    void process_submit();
+    void reap_completion();
+
+    // -- profile
+    uint64_t profile_desc_count;
+    double profile_byte_size;
+    double profile_latency;
+
+};
@@ -0,0 +1,149 @@
+#pragma once
+#include <systemc>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <unordered_map>
+
+// instrumentation policy, chosen at compile time, e.g.
+//   make DEFINES=-DPCIeInstrumentPolicy=PCIeCounterInstrument
+//   make DEFINES='-DPCIeInstrumentPolicy=PCIeInstrumentChain<PCIeCounterInstrument,PCIeTraceInstrument>'
+// a custom consumer is a struct with the same three members, brought in with -include my_policy.hpp
+#ifndef PCIeInstrumentPolicy
+#define PCIeInstrumentPolicy      PCIeNoInstrument
+#endif
+#define PCIeTraceInstrumentPath   "hooks.csv"
+
+enum class PCIeHook {
+    SendTLP,        // accepted into the internal buffer
+    CreditAcquire,  // credits taken for the TLP about to be built
+    CreditStall,    // no VC has a TLP with credits and tag, once per stall
+    TagAllocate,
+    TagRelease,
+    InsertTLP,      // written to the replay buffer
+    Transmit,       // onto the link
+    Receive,        // TLP arrived at the data link / transaction layer
+    Ack,            // Ack received, replay buffer entry released
+    UpdateFC,       // UpdateFC received, credits returned
+    Count,
+};
+
+inline const char* pcie_hook_name(PCIeHook hook)
+{
+    static const char* names[] = {"SendTLP", "CreditAcquire", "CreditStall", "TagAllocate", "TagRelease", "InsertTLP", "Transmit", "Receive", "Ack", "UpdateFC"};
+    return names[static_cast<int>(hook)];
+}
+
+struct PCIeHookEvent {
+    PCIeHook hook;
+    uint8_t type;       // PCIeTLPType, PCIeCreditType for credit hooks
+    uint8_t vc;
+    uint8_t tag;
+    uint32_t seqNum;
+    uint32_t header;    // header credits
+    uint32_t length;    // DW, payload credits for credit hooks
+};
+
+inline PCIeHookEvent pcie_hook_event(PCIeHook hook, uint32_t type = 0, uint32_t vc = 0, uint32_t tag = 0, uint32_t seqNum = 0, uint32_t header = 0, uint32_t length = 0)
+{
+    return {hook, static_cast<uint8_t>(type), static_cast<uint8_t>(vc), static_cast<uint8_t>(tag), seqNum, header, length};
+}
+
+// hook site in a layer member function, discarded at compile time unless the policy is enabled
+//   PCIE_HOOK(hook, type, vc, tag, seqNum, header, length), trailing fields may be left out
+#define PCIE_HOOK(...) \
+    do { \
+        if constexpr (PCIeInstrumentPolicy::enabled) { \
+            PCIeInstrumentPolicy::on(*this, this->name(), pcie_hook_event(__VA_ARGS__)); \
+        } \
+    } while (0)
+
+struct PCIeNoInstrument {
+    static constexpr bool enabled = false;
+    template <typename Layer>
+    static void on(const Layer&, const char*, const PCIeHookEvent&) {}
+    static void report() {}
+};
+
+// event count per layer and hook
+struct PCIeCounterInstrument {
+    static constexpr bool enabled = true;
+
+    template <typename Layer>
+    static void on(const Layer&, const char* name, const PCIeHookEvent& event) {
+        counts()[name][static_cast<int>(event.hook)]++;
+    }
+
+    static void report() {
+        for (const auto& layer : counts()) {
+            std::cout << "[Instrument] " << layer.first << ":";
+            for (int hook = 0; hook < static_cast<int>(PCIeHook::Count); hook++) {
+                if (layer.second[hook] > 0) {
+                    std::cout << " " << pcie_hook_name(static_cast<PCIeHook>(hook)) << "=" << layer.second[hook];
+                }
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    // keyed by the layer's name() storage, stable for the layer's lifetime
+    static std::unordered_map<const char*, std::array<uint64_t, static_cast<int>(PCIeHook::Count)>>& counts() {
+        static std::unordered_map<const char*, std::array<uint64_t, static_cast<int>(PCIeHook::Count)>> table;
+        return table;
+    }
+};
+
+// one CSV line per event in PCIeTraceInstrumentPath
+struct PCIeTraceInstrument {
+    static constexpr bool enabled = true;
+
+    template <typename Layer>
+    static void on(const Layer&, const char* name, const PCIeHookEvent& event) {
+        FILE *out = file();
+        if (out != nullptr) {
+            fprintf(out, "%.0f,%s,%s,%d,%d,%d,%u,%u,%u\n", sc_core::sc_time_stamp().to_double(), name, pcie_hook_name(event.hook), event.type, event.vc, event.tag, event.seqNum, event.header, event.length);
+        }
+    }
+
+    static void report() {
+        FILE *out = file();
+        if (out != nullptr) {
+            fflush(out);
+        }
+    }
+
+    static FILE* file() {
+        static FILE *out = nullptr;
+        if (out == nullptr) {
+            out = fopen(PCIeTraceInstrumentPath, "w");
+            if (out != nullptr) {
+                fprintf(out, "time_ps,layer,hook,type,vc,tag,seqNum,header,length\n");
+            }
+        }
+        return out;
+    }
+};
+
+// several consumers at once, disabled ones cost nothing
+template <typename... Policies>
+struct PCIeInstrumentChain {
+    static constexpr bool enabled = (Policies::enabled || ...);
+
+    template <typename Layer>
+    static void on(const Layer& layer, const char* name, const PCIeHookEvent& event) {
+        (dispatch<Policies>(layer, name, event), ...);
+    }
+
+    static void report() {
+        (Policies::report(), ...);
+    }
+
+private:
+    template <typename Policy, typename Layer>
+    static void dispatch(const Layer& layer, const char* name, const PCIeHookEvent& event) {
+        if constexpr (Policy::enabled) {
+            Policy::on(layer, name, event);
+        }
+    }
+};
@@ -5,11 +5,21 @@
 #include <tlm_utils/simple_target_socket.h>
 #include <tlm_utils/peq_with_cb_and_phase.h>
 #include <queue>
+#include <deque>
 #include <map>
+#include <array>
 #include <unordered_map>
+#include <functional>
+#include <memory>
 #include "utils.hpp"
 #include "log.hpp"
 #include "pcie_tlp_extension.hpp"
+#include "pcie_ordering.hpp"
+#include "pcie_peq.hpp"
+#include "pcie_pipeline.hpp"
+#include "pcie_instrument.hpp"
+#include "checkpoint.hpp"
+#include "pcie_scoreboard.hpp"
 
 using namespace sc_core;
 
@@ -18,13 +28,129 @@ class PCIeTransactionLayer;
 #define TLInternalBufferSize  1024
 #define DLLReplayBufferSize   1024
 #define TLTagCount            64
-#define ReplayBufferCredits   1024
+#define ReplayBufferCredits   3072  // header and DW credits, split evenly over P, NP and Cpl
+#define PCIeMaxPayloadSize    256   // byte
+#define PCIeMaxReadReqSize    512   // byte
+#define PCIeBoundarySize      4096  // byte, TLP must not cross
+#define PCIeMaxVCCount        8
+#ifndef TLVCCount
+#define TLVCCount             1     // virtual channels in use, shares buffer and credits evenly
+#endif
+#define TLOrderingEnable      1     // let TLPs pass each other as the ordering table allows
+#define TLOrderingWindow      16    // TLPs searched per VC for one that may pass
+#ifndef DLLPEQType
+#define DLLPEQType            PCIePEQType::Wheel
+#endif
+
+// receive buffer drain, a TLP's credits return only after its entry is freed
+#define RxDrainBackend        0     // freed when the receiver's handler lets go, e.g. memory backend accept
+#define RxDrainFixed          1     // additionally drained in order per credit class at a fixed rate
+#ifndef RxDrainMode
+#define RxDrainMode           RxDrainBackend
+#endif
+#ifndef RxDrainDWPerNs
+#define RxDrainDWPerNs        8     // RxDrainFixed
+#endif
+#define RxDrainHeaderNs       1     // RxDrainFixed, per TLP
+#define UpdateFCHeaderThreshold   4     // freed headers worth an UpdateFC
+#define UpdateFCPayloadThreshold  64    // freed DW worth an UpdateFC, one MPS
+#define UpdateFCTimer         500   // ns, freed credits are never held back longer
+
+// controller pipeline timing per layer, 0 stages keeps that path zero-time
+#define TLClockMHz            1000
+#define TLDatapathDW          8     // DW per cycle
+#ifndef TLTxStages
+#define TLTxStages            4     // arbitration, credit / tag check, header build, internal buffer read
+#endif
+#ifndef TLRxStages
+#define TLRxStages            3     // header decode, ordering check, hand to the application
+#endif
+#define DLLClockMHz           1000
+#define DLLDatapathDW         8
+#ifndef DLLTxStages
+#define DLLTxStages           3     // seqNum, replay buffer write, LCRC
+#endif
+#ifndef DLLRxStages
+#define DLLRxStages           4     // LCRC check, seqNum check, Ack schedule, hand to TL
+#endif
+#define DLLPProcessCycles     4     // Ack / UpdateFC handled at the TLP sender
+
+// physical link
+#define LinkNsPerDW           2     // ns on the wire per payload DW
+#define LinkFlightTime        10    // ns, propagation across the link, every TLP and DLLP
+#define DLLPFlightTime        LinkFlightTime    // Ack / UpdateFC back to the TLP sender
+
+// ASPM, power states entered after idle timers, left with an exit latency on the next TLP / DLLP
+#define ASPMDisabled          0
+#define ASPML0s               1     // transmitter standby, per direction
+#define ASPML1                2     // whole link, both directions idle
+#define ASPML0sL1             3
+#ifndef ASPMControl
+#define ASPMControl           ASPMDisabled
+#endif
+#ifndef ASPML0sIdleTime
+#define ASPML0sIdleTime       1000  // ns transmitter idle before L0s
+#endif
+#ifndef ASPML1IdleTime
+#define ASPML1IdleTime        10000 // ns link idle before L1
+#endif
+#ifndef ASPML0sExitLatency
+#define ASPML0sExitLatency    256   // ns
+#endif
+#ifndef ASPML1ExitLatency
+#define ASPML1ExitLatency     4000  // ns
+#endif
+
+enum class PCIeASPMState {
+    L0      = 0,
+    L0s     = 1,
+    L1      = 2,
+    Exit    = 3,    // retraining back to L0
+};
+#define PCIeASPMStateCount    4
+
+#define TLLatencyHistBucket   4     // ns, send latency histogram for percentiles
+#define TLLatencyHistSize     4096  // buckets, the last one takes everything beyond
+
+// resource sizes, the macros above are the defaults, the sizing search overrides them per run
+struct PCIeResourceConfig {
+    uint32_t internalBufferSize = TLInternalBufferSize;   // DW
+    uint32_t replayBufferSize = DLLReplayBufferSize;      // TLP headers, and DW of payload
+    uint32_t tagCount = TLTagCount;
+    uint32_t credits = ReplayBufferCredits;               // header and DW credits over all classes and VCs
+};
+
+PCIeResourceConfig& pcie_resource_config();
 
 struct DLL_transaction {
     uint32_t replayBufferHeader_base;
     uint32_t headerLength;
     uint32_t replayBufferPayload_base;
     uint32_t payloadLength;
+    uint64_t checksum;      // of the submitted payload
+    uint8_t vc;
+    double tlFill;          // ns, TL pipeline fill of this TLP, rides on its link delay
+};
+
+struct DLL_rxCredit {
+    PCIeTLPCredit capacity;         // advertised at link up
+    PCIeTLPCredit held;             // received and not yet returned by UpdateFC
+    PCIeTLPCredit freed;            // drained, waiting for UpdateFC
+    sc_core::sc_time drainFree;     // RxDrainFixed, class drain busy until
+    sc_core::sc_time freedSince;    // oldest freed credit not yet returned
+    uint32_t profile_max_held;
+};
+
+struct DLL_rxRelease {
+    sc_core::sc_time time;
+    uint64_t seq;
+    uint8_t vc;
+    PCIeCreditType type;
+    uint32_t payload;
+
+    bool operator>(const DLL_rxRelease& other) const {
+        return (time != other.time) ? (time > other.time) : (seq > other.seq);
+    }
 };
 
 class PCIeDataLinkLayer
@@ -38,22 +164,56 @@ public:
     : sc_core::sc_module(name),
       s_out("data_link_layer_tx"),
       s_in("data_link_layer_rx"),
-      m_peq(this, &PCIeDataLinkLayer::peq_callback),
-      requesterID(id)
+      requesterID(id),
+      m_transactionLayer(nullptr),
+      txPipeline(DLLClockMHz, DLLTxStages, DLLDatapathDW),
+      rxPipeline(DLLClockMHz, DLLRxStages, DLLDatapathDW)
     {
         // SC_THREAD(process_TLP_to_DLLP);
         SC_THREAD(process_DLLTrans_queue);
+        SC_THREAD(process_rx_drain);
 
         s_out.register_nb_transport_bw(this, &PCIeDataLinkLayer::nb_transport_bw);
         s_in.register_nb_transport_fw(this, &PCIeDataLinkLayer::nb_transport_fw);
+        s_in.register_b_transport(this, &PCIeDataLinkLayer::b_transport);
+        s_in.register_get_direct_mem_ptr(this, &PCIeDataLinkLayer::get_direct_mem_ptr);
+        s_in.register_transport_dbg(this, &PCIeDataLinkLayer::transport_dbg);
+        s_out.register_invalidate_direct_mem_ptr(this, &PCIeDataLinkLayer::invalidate_direct_mem_ptr);
+        set_peq_type(DLLPEQType);
 
-        seqNumCount = DLLReplayBufferSize;
+        seqNumCount = pcie_resource_config().replayBufferSize;
         init_seqNumPool(seqNumCount);
         init_replayBuffer(seqNumCount);
         replayBufferHeader_head = 0;
         replayBufferHeader_tail = 0;
         replayBufferPayload_head = 0;
         replayBufferPayload_tail = 0;
+        txPaused = false;
+        txParked = false;
+        functional = false;
+        dmiValid = false;
+        progress_tlp_sent = 0;
+        progress_ack = 0;
+        m_scoreboard = nullptr;
+        init_rx_credits(TLVCCount);
+        rxReleaseSeq = 0;
+        profile_update_fc_count = 0;
+        rxDeliveryPending = 0;
+        aspmTxIdle = SC_ZERO_TIME;
+        aspmRxLast = SC_ZERO_TIME;
+        aspmAccounted = SC_ZERO_TIME;
+        aspmReady = SC_ZERO_TIME;
+
+        // profiling
+        for (int state = 0; state < PCIeASPMStateCount; state++) {
+            profile_aspm_residency[state] = 0;
+            profile_aspm_exit[state] = 0;
+        }
+        profile_aspm_tlp_count = 0;
+        profile_aspm_tlp_delayed = 0;
+        profile_aspm_dllp_delayed = 0;
+        profile_aspm_penalty = 0;
+        profile_aspm_max_penalty = 0;
 
         SC_LOG(INFO, "init done");
     }
@@ -61,7 +221,9 @@ public:
     // TLM component
     tlm_utils::simple_initiator_socket<PCIeDataLinkLayer> s_out;
     tlm_utils::simple_target_socket<PCIeDataLinkLayer> s_in;
-    tlm_utils::peq_with_cb_and_phase<PCIeDataLinkLayer> m_peq;
+    std::unique_ptr<tlm_utils::peq_with_cb_and_phase<PCIeDataLinkLayer>> m_peq;
+    std::unique_ptr<PCIeWheelPEQ<PCIeDataLinkLayer>> m_wheelPeq;
+    PCIePEQType peqType;    // queue used by s_in, only that one is constructed
     sc_core::sc_event event_TLPToDLLP;
 
     // General Component
@@ -81,6 +243,7 @@ public:
     std::vector<PCIeTLPPayload> replayBuffer_payload;
     int32_t replayBufferHeader_head, replayBufferHeader_tail;
     int32_t replayBufferPayload_head, replayBufferPayload_tail;
+    sc_core::sc_time lastDLLPTime;    // arrival of the latest Ack / UpdateFC sent to the link partner
 
     //  ====================================
     //  public function can be used by other
@@ -88,7 +251,40 @@ public:
 
     // DLLP layer function
     int send_DLLP();
-    int insert_TLP(PCIeTLPHeader header, uint32_t payload_index);
+    int insert_TLP(PCIeTLPHeader header, uint8_t vc, uint32_t payload_index, uint32_t payload_length, uint64_t checksum, sc_core::sc_time tl_fill);
+    void set_peq_type(PCIePEQType type);    // elaboration only
+    void set_scoreboard(PCIeScoreboard *scoreboard);
+
+    // checkpoint, transmit is paused so the link can drain before saving
+    void pause_transmit();
+    void resume_transmit();
+    bool link_is_idle();
+
+    // sampling, fast-forward delivers TLPs through b_transport without DLLPs
+    void set_functional(bool enable);
+    void transmit_functional(const PCIeTLPHeader& header, uint8_t vc, std::vector<PCIeTLPPayload>* payloads);
+    bool write_direct(uint64_t address, std::vector<PCIeTLPPayload>* payloads);
+    void save(CheckpointWriter& writer);
+    bool restore(CheckpointReader& reader);
+
+    // DMI and debug access on the target socket, answered by the link partner's memory
+    void register_direct_mem_ptr(std::function<bool(uint64_t, tlm::tlm_dmi&)> handler);
+    void register_transport_dbg(std::function<unsigned int(uint64_t, unsigned char*, unsigned int, bool)> handler);
+
+    // watchdog
+    bool has_pending_work();
+    uint64_t get_progress();
+    void dump_state();
+
+    void report_rx_stats();
+    void report_pipeline_stats();
+    void report_aspm_stats();
+
+    // live stats
+    uint32_t get_unacked();
+    uint32_t get_replay_header_used();
+    uint32_t get_replay_payload_used();
+    uint32_t get_replay_size();
 
 private:
 
@@ -99,8 +295,64 @@ private:
     void process_TLP_to_DLLP();
     void process_DLLTrans_queue();
 
+    // checkpoint
+    bool txPaused;
+    bool txParked;
+    sc_core::sc_event event_txResume;
+
+    // sampling
+    bool functional;
+    tlm::tlm_dmi dmi;       // link partner memory granted over s_out, dropped on every mode change
+    bool dmiValid;
+    std::function<bool(uint64_t, tlm::tlm_dmi&)> dmi_handler;
+    std::function<unsigned int(uint64_t, unsigned char*, unsigned int, bool)> dbg_handler;
+
+    // watchdog
+    uint64_t progress_tlp_sent;
+    uint64_t progress_ack;
+
+    // end-to-end payload check
+    PCIeScoreboard *m_scoreboard;
+
+    // receive buffer per VC and credit class
+    std::vector<std::array<DLL_rxCredit, PCIeCreditTypeCount>> rxCredits;
+    std::priority_queue<DLL_rxRelease, std::vector<DLL_rxRelease>, std::greater<DLL_rxRelease>> rxRelease;
+    uint64_t rxReleaseSeq;
+    sc_core::sc_event event_rxDrain;
+    uint64_t profile_update_fc_count;
+    void init_rx_credits(uint32_t vc_count);
+    void receive_credits(uint8_t vc, PCIeCreditType type, uint32_t payload, sc_core::sc_time hold_time);
+    bool update_FC_is_due(const DLL_rxCredit& rx);
+    void send_update_FC(uint8_t vc, PCIeCreditType type);
+    void process_rx_drain();
+    bool rx_is_drained();
+
+    // controller pipeline, a received TLP waits in the PEQ for the TL pipeline after its Ack went out
+    PCIePipeline txPipeline;
+    PCIePipeline rxPipeline;
+    uint32_t rxDeliveryPending;
+    void deliver_TLP(tlm::tlm_generic_payload& trans);
+
+    // ASPM, state of this transmit direction worked out from idle times when the link is next used
+    sc_core::sc_time aspmTxIdle;        // transmitter idle from, ahead of now while a TLP is on the wire
+    sc_core::sc_time aspmRxLast;        // latest TLP / DLLP from the link partner
+    sc_core::sc_time aspmAccounted;     // residency counted up to
+    sc_core::sc_time aspmReady;         // end of the latest exit
+    PCIeASPMState aspm_state(const sc_core::sc_time& now);
+    void aspm_account(const sc_core::sc_time& now);
+    sc_core::sc_time aspm_wake(const sc_core::sc_time& busy, bool tlp);
+    void aspm_receive();
+    double profile_aspm_residency[PCIeASPMStateCount];
+    uint64_t profile_aspm_exit[PCIeASPMStateCount];
+    uint64_t profile_aspm_tlp_count;
+    uint64_t profile_aspm_tlp_delayed;
+    uint64_t profile_aspm_dllp_delayed;
+    double profile_aspm_penalty;
+    double profile_aspm_max_penalty;
+
     // PEQ callback
     void peq_callback (tlm::tlm_generic_payload& trans, const tlm::tlm_phase& phase);
+    void peq_notify(tlm::tlm_generic_payload& trans, const tlm::tlm_phase& phase, const sc_core::sc_time& delay);
 
     // seqNumber
     void init_seqNumPool(uint32_t count);
@@ -123,7 +375,43 @@ private:
 struct TL_transaction {
     PCIeTLPType type;
     uint32_t internal_buffer_base;
-    uint32_t length;
+    uint32_t length;        // payload DW held in internal buffer
+    uint32_t lengthDW;      // header Length field
+    uint64_t address;
+    uint16_t reqID;         // completion: of its request, request: this BDF with the issuing function
+    uint8_t tag;            // completion only
+    uint32_t context;       // non-posted only, requester's id for the request, looked up by tag on completion
+    uint8_t tc;
+    uint8_t attr;
+    uint8_t at;
+    uint64_t buffer_seq;    // internal buffer allocation order
+    uint64_t checksum;      // of the submitted payload
+    sc_core::sc_time timestamp;
+};
+
+enum class PCIeVCArbitration {
+    StrictPriority,         // higher VC first
+    RoundRobin,
+    WeightedRoundRobin,
+};
+
+struct TL_virtualChannel {
+    std::deque<TL_transaction> internalTrans_queue;
+    std::vector<uint32_t> internalBuffer;
+    int32_t internalBufferSize, internalBufferHead, internalBufferTail;
+    std::deque<std::pair<uint32_t, bool>> internalBuffer_alloc;    // {length, sent} in allocation order
+    uint64_t internalBuffer_seq;                                    // buffer_seq of internalBuffer_alloc.front()
+    uint32_t internalBuffer_released;                               // DW returned by UpdateFC, not yet freed
+    PCIeTLPCredit credits[PCIeCreditTypeCount];
+    uint32_t weight;
+    uint32_t grant;
+
+    // profile
+    uint64_t profile_tlp_count;
+    double profile_byte_size;
+    double profile_latency;
+    double profile_max_latency;
+    uint64_t profile_bypass_count;
 };
 
 class PCIeTransactionLayer
@@ -134,15 +422,20 @@ public:
     PCIeTransactionLayer(sc_core::sc_module_name name, unsigned int id, PCIeDataLinkLayer *m_dataLinkLayer_)
     : sc_core::sc_module(name),
       requesterID(id),
-      m_dataLinkLayer(m_dataLinkLayer_)
+      m_dataLinkLayer(m_dataLinkLayer_),
+      txPipeline(TLClockMHz, TLTxStages, TLDatapathDW),
+      rxPipeline(TLClockMHz, TLRxStages, TLDatapathDW)
     {
-        set_credits(ReplayBufferCredits, ReplayBufferCredits);
-        init_tag_pool(TLTagCount);
-        
-        internalBufferSize = TLInternalBufferSize;
-        internalBufferHead = 0;
-        internalBufferTail = 0;
-        internalBuffer.resize(internalBufferSize, 0x00);
+        init_virtual_channel(TLVCCount);
+        set_credits(pcie_resource_config().credits, pcie_resource_config().credits);
+        init_tag_pool(pcie_resource_config().tagCount);
+        profile_latency_hist.resize(TLLatencyHistSize, 0);
+        profile_rx_byte_size = 0;
+        pendingInsert = false;
+        progress_completion = 0;
+        sendBlocked = false;
+        creditStalled = false;
+        functional = false;
 
         SC_THREAD(process_build_TLP);
         SC_LOG(INFO, "init done");
@@ -154,22 +447,69 @@ public:
     unsigned int requesterID;
 
     // Transaction Layer Component
-    PCIeTLPCredit credits;
     std::queue<uint8_t> tagPool;
-    std::queue<TL_transaction> internalTrans_queue;
-    std::vector<uint32_t> internalBuffer;
-    int32_t internalBufferSize, internalBufferHead, internalBufferTail;
+    std::vector<TL_virtualChannel> vcs;
+    uint8_t tcToVC[PCIeMaxVCCount];
+    PCIeVCArbitration vcArbitration;
+    uint8_t lastVC;
+    bool orderingEnable;
     sc_core::sc_event event_internalTrans;
+    std::map<uint8_t, uint32_t> outstandingNP; // tag -> DW still to be completed
+    std::map<uint8_t, uint32_t> tagContext;    // tag -> context of the non-posted request
 
     //  ====================================
     //  public function can be used by other
     //  ====================================
-    void release_credits(uint32_t header, uint32_t payload);
+    void release_credits(uint8_t vc, PCIeCreditType type, uint32_t header, uint32_t payload);
     void release_tag(uint8_t tag);
 
     // TLP layer function
-    bool send_TLP(PCIeTLPType type, std::vector<PCIeTLPPayload>* payloads);
-    uint32_t get_internalBuffer_dw(uint32_t index);
+    bool send_TLP(PCIeTLPType type, std::vector<PCIeTLPPayload>* payloads, uint64_t address = 0, uint8_t tc = 0, uint8_t attr = 0, uint8_t at = PCIeATUntranslated, uint8_t func = 0);
+    bool send_read_TLP(uint64_t address, uint32_t lengthDW, uint8_t tc = 0, uint8_t attr = 0, uint8_t at = PCIeATUntranslated, uint32_t context = 0, uint8_t func = 0);
+    uint32_t get_tag_context(uint8_t tag);
+    bool send_completion(const PCIeTLPHeader& request, uint64_t address, std::vector<PCIeTLPPayload>* payloads);
+    uint32_t get_internalBuffer_dw(uint8_t vc, uint32_t index);
+
+    // virtual channel function
+    uint8_t tc_to_vc(uint8_t tc);
+    void set_tc_vc_map(uint8_t tc, uint8_t vc);
+    void set_vc_arbitration(PCIeVCArbitration arbitration);
+    void set_vc_weight(uint8_t vc, uint32_t weight);
+    void report_vc_stats();
+    void set_ordering_enable(bool enable);
+
+    // checkpoint
+    void save(CheckpointWriter& writer);
+    bool restore(CheckpointReader& reader);
+
+    // sampling, fast-forward hands TLPs straight to the data link layer
+    void set_functional(bool enable);
+    bool tx_is_idle();
+
+    // watchdog
+    bool has_pending_work();
+    uint64_t get_progress();
+    void dump_state();
+
+    // controller pipeline
+    sc_core::sc_time pass_rx_pipeline(uint32_t lengthDW);
+    void report_pipeline_stats();
+
+    // live stats
+    PCIeTLPCredit get_credits(uint8_t vc, PCIeCreditType type);
+    uint32_t get_internal_buffer_used();
+    uint32_t get_internal_buffer_size();
+    uint32_t get_outstanding_NP();
+
+    // sizing search
+    double get_throughput();
+    double get_rx_throughput();
+    double get_latency_percentile(double fraction);
+    double get_latency_mean();
+
+    // receive path, called by data link layer
+    sc_core::sc_time receive_TLP(const PCIeTLPHeader& header, std::vector<PCIeTLPPayload>* payloads, uint8_t vc);
+    void register_receive_TLP(std::function<sc_core::sc_time(const PCIeTLPHeader&, std::vector<PCIeTLPPayload>*)> handler);
 
 private:
 
@@ -178,18 +518,61 @@ private:
     //  ===============================================
     
     void process_build_TLP();
+    bool push_internalTrans(TL_transaction& tlp_trans, std::vector<PCIeTLPPayload>* payloads);
+    bool internalTrans_pending(void);
+    bool select_vc(uint8_t& vc, size_t& index);
+    bool vc_is_ready(uint8_t vc, size_t& index);
+    bool TLP_is_ready(uint8_t vc, const TL_transaction& tlp_trans);
+    // ordering is applied here, where the transmitter picks the next TLP; the receiver hands TLPs
+    // up in link order and does not reorder them again at ingress
+    bool TLP_may_bypass(uint8_t vc, size_t index);
+    PCIeOrderingKey get_ordering_key(const TL_transaction& tlp_trans);
+    uint16_t function_id(uint8_t func);
+    void retire_internalBuffer(uint8_t vc);
+    void init_virtual_channel(uint32_t count);
+    void build_header(const TL_transaction& tlp_trans, uint8_t tag, PCIeTLPHeader& header);
+    bool insert_pending_TLP();
+    bool send_functional(TL_transaction& tlp_trans, std::vector<PCIeTLPPayload>* payloads);
+
+    // TLP built and waiting for room in the replay buffer
+    bool pendingInsert;
+    uint8_t pendingVC;
+    TL_transaction pendingTrans;
+    PCIeTLPHeader pendingHeader;
+    sc_core::sc_time pendingFill;
 
     // DLLP layer component
     PCIeDataLinkLayer *m_dataLinkLayer;
 
+    // watchdog
+    uint64_t progress_completion;
+    bool sendBlocked;       // last send refused for lack of internal buffer
+    bool creditStalled;     // instrumentation, stall reported once until a TLP goes again
+
+    // sampling
+    bool functional;
+
+    // upper layer receive handler
+    std::function<sc_core::sc_time(const PCIeTLPHeader&, std::vector<PCIeTLPPayload>*)> rx_handler;
+
+    // send latency over all VCs
+    std::vector<uint64_t> profile_latency_hist;
+
+    // payload handed to the upper layer, what actually crossed the link
+    double profile_rx_byte_size;
+
+    // controller pipeline, the tx fill goes on with the TLP as delay annotated by the data link layer
+    PCIePipeline txPipeline;
+    PCIePipeline rxPipeline;
+
     // tag pool function
     void init_tag_pool(uint32_t count);
     bool tag_pool_is_empty(void);
     bool allocate_tag(uint8_t& tag);
 
     // credits function
-    bool acquire_credits(uint32_t header, uint32_t payload);
-    bool allocate_credits(uint32_t header, uint32_t payload);
+    bool acquire_credits(uint8_t vc, PCIeCreditType type, uint32_t header, uint32_t payload);
+    bool allocate_credits(uint8_t vc, PCIeCreditType type, uint32_t header, uint32_t payload);
     void set_credits(uint32_t header, uint32_t payload);
 
 };
\ No newline at end of file
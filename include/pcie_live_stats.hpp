@@ -0,0 +1,59 @@
+#pragma once
+#include <systemc>
+#include <chrono>
+#include <string>
+#include "log.hpp"
+#include "pcie_requester.hpp"
+#include "pcie_stats_shm.hpp"
+
+using namespace sc_core;
+
+#ifndef LiveStatsEnable
+#define LiveStatsEnable       0
+#endif
+#define LiveStatsCheckInterval  10000   // ns simulated between wall clock checks
+#define LiveStatsPeriod       200       // ms wall time between updates
+
+// publishes counters of a running simulation to LiveStatsShmPrefix<pid> for the stats viewer,
+// the thread only reads the wall clock every LiveStatsCheckInterval ns so it stays off the hot path,
+// SIGINT / SIGTERM unlink the segment so a killed run leaves nothing behind
+class PCIeLiveStats
+: sc_core::sc_module
+{
+public:
+    PCIeLiveStats(sc_core::sc_module_name name, PCIeRequester_ *m_requester_)
+    : sc_core::sc_module(name),
+      m_requester(m_requester_),
+      shm(nullptr)
+    {
+        start = std::chrono::steady_clock::now();
+        lastPublish = start;
+        if (LiveStatsEnable) {
+            open_shm();
+            SC_THREAD(process_publish);
+        }
+
+        // profiling
+        profile_publish_count = 0;
+    }
+
+    ~PCIeLiveStats();
+
+private:
+
+    // -- component
+    PCIeRequester_ *m_requester;
+    PCIeLiveStatsShm *shm;
+    std::string shmName;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point lastPublish;
+
+    // -- function
+    void open_shm();
+    void process_publish();
+    void publish(bool done);
+
+    // -- profile
+    uint64_t profile_publish_count;
+
+};
@@ -0,0 +1,92 @@
+#pragma once
+#include <array>
+#include <string>
+#include <vector>
+#include "log.hpp"
+#include "memory_backend.hpp"
+#include "pcie_layers.hpp"
+#include "pcie_requester.hpp"
+#include "pcie_sizing.hpp"
+
+#define ModelFixedPointPass   32        // throughput / UpdateFC coalescing iterations
+#define ModelCombinePass      256       // write combiner Markov chain iterations
+#define ModelBindingMargin    0.001     // a window within this of the slowest station leaves the station binding
+#define ModelTailQuantile     2.326     // standard normal 99th percentile
+#define ModelScreenScale      4         // screening grid goes up to this multiple of the macro defaults
+#define ModelScreenSimulate   4         // smallest screened configurations confirmed by simulation
+
+enum class PCIeModelResource {
+    Requester,
+    TLPipeline,
+    DLLPipeline,
+    Link,
+    RxDrain,
+    InternalBuffer,
+    CreditHeader,
+    CreditPayload,
+    Tag,
+    ReplayHeader,
+    ReplayPayload,
+    Count,
+};
+
+const char* pcie_model_resource_name(PCIeModelResource resource);
+
+// random traffic of the requester, posted writes through the write combiner
+struct PCIeModelWorkload {
+    uint32_t minDW = RequesterMinDW;
+    uint32_t maxDW = RequesterMaxDW;
+    double issueInterval = RequesterIssueInterval;              // ns between writes
+    double sequential = RequesterSequentialPercent / 100.0;     // writes that follow on from the previous one
+    uint32_t combineWrites = WriteCombineEnable ? std::max(WriteCombineTimeout / RequesterIssueInterval, 1) : 1;
+};
+
+struct PCIeModelResult {
+    double throughput;          // GB/s
+    double mean_latency;        // ns, internal buffer to replay buffer, same as the TL send latency
+    double p99_latency;         // ns
+    double tlp_length;          // DW per TLP after write combining
+    PCIeModelResource binding;
+    std::array<double, static_cast<int>(PCIeModelResource::Count)> bound;  // GB/s the resource alone allows
+};
+
+// closed form / MVA model of requester -> TL -> DLL -> link -> completer, random traffic only
+//   stations: requester issue, TL and DLL pipelines, link serialization, receive drain or memory backend
+//   windows: internal buffer, credits, tags, replay buffer, each a closed loop around the
+//            bottleneck station solved by exact single class MVA
+//   the source is saturated unless the requester binds, then the queue builds in front of the
+//   bottleneck and spills outward into the windows that enclose it, each credit return lets a
+//   burst of TLPs into the TL pipeline that queue behind one another
+class PCIeAnalyticModel
+{
+public:
+    PCIeAnalyticModel(const PCIeModelWorkload& workload_);
+
+    //  ====================================
+    //  public function can be used by other
+    //  ====================================
+    PCIeModelResult predict(const PCIeResourceConfig& config);
+    void report(const PCIeModelResult& result);
+    void report_divergence(const PCIeModelResult& result, const PCIeSizingResult& simulated);
+    const char* name() const { return "Model"; }
+
+private:
+
+    // -- component
+    PCIeModelWorkload workload;
+    std::vector<double> lengthPMF;      // TLP length in DW after write combining
+    double writesPerTLP;
+
+    // -- function
+    void combine_lengths();
+    double expect_beats(uint32_t width, uint32_t power);
+    uint32_t percentile_beats(uint32_t width, double fraction);
+    double update_fc_batch(std::vector<double>& reach);
+    double backend_demand();
+    void burst_latency(double interval, const std::vector<double>& reach, double& mean, double& p99);
+    static double mva(double population, double service, double delay);
+
+    // -- profile
+    uint64_t profile_predict_count;
+
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include "pcie_tlp_extension.hpp"
+
+// PCIe transaction ordering table (base spec, Table 2-40)
+// row: later TLP, column: earlier TLP, result tells whether row may pass column
+enum class PCIeOrderingResult {
+    No,         // must not pass
+    YesNo,      // may pass
+    Yes,        // must be able to pass
+};
+
+struct PCIeOrderingKey {
+    PCIeTLPType type;
+    uint8_t attr;
+    uint16_t streamID;      // requester ID, or completer ID of a completion
+    uint16_t reqID;
+    uint8_t tag;
+};
+
+constexpr PCIeOrderingResult get_ordering_rule(const PCIeOrderingKey& row, const PCIeOrderingKey& col)
+{
+    bool relaxed = row.attr & PCIeAttrRelaxed;
+    bool ido = (row.attr & PCIeAttrIDO) && (row.streamID != col.streamID);
+
+    if (is_posted(row.type)) {
+        if (is_posted(col.type)) {
+            return (relaxed || ido) ? PCIeOrderingResult::YesNo : PCIeOrderingResult::No;   // A2
+        }
+        return PCIeOrderingResult::Yes;                                                     // A3, A4, A5
+    }
+
+    if (is_completion(row.type)) {
+        if (is_posted(col.type)) {
+            return (relaxed || ido) ? PCIeOrderingResult::YesNo : PCIeOrderingResult::No;   // D2
+        }
+        if (is_completion(col.type)) {
+            bool same_request = (row.reqID == col.reqID) && (row.tag == col.tag);
+            return same_request ? PCIeOrderingResult::No : PCIeOrderingResult::YesNo;       // D5
+        }
+        return PCIeOrderingResult::Yes;                                                     // D3, D4
+    }
+
+    // non-posted request
+    if (is_posted(col.type)) {
+        return ido ? PCIeOrderingResult::YesNo : PCIeOrderingResult::No;                    // B2, C2
+    }
+    return PCIeOrderingResult::YesNo;                                                       // B3~B5, C3~C5
+}
+
+constexpr bool ordering_may_pass(const PCIeOrderingKey& row, const PCIeOrderingKey& col, bool allow_yes_no)
+{
+    PCIeOrderingResult result = get_ordering_rule(row, col);
+    return (result == PCIeOrderingResult::Yes) || (allow_yes_no && result == PCIeOrderingResult::YesNo);
+}
+
+// IDO lets a TLP pass a blocked posted write only when that write belongs to another stream
+static_assert(ordering_may_pass({PCIeTLPType::MRd, PCIeAttrIDO, 2, 2, 0}, {PCIeTLPType::MWr, 0, 1, 1, 0}, true), "IDO read passes a write of another stream");
+static_assert(!ordering_may_pass({PCIeTLPType::MRd, PCIeAttrIDO, 1, 1, 0}, {PCIeTLPType::MWr, 0, 1, 1, 0}, true), "IDO read stays behind a write of its own stream");
+static_assert(ordering_may_pass({PCIeTLPType::MWr, PCIeAttrIDO, 2, 2, 0}, {PCIeTLPType::MWr, 0, 1, 1, 0}, true), "IDO write passes a write of another stream");
+static_assert(!ordering_may_pass({PCIeTLPType::MWr, 0, 2, 2, 0}, {PCIeTLPType::MWr, 0, 1, 1, 0}, true), "strict write stays behind any write");
+static_assert(ordering_may_pass({PCIeTLPType::CplD, PCIeAttrIDO, 3, 1, 0}, {PCIeTLPType::MWr, 0, 1, 1, 0}, true), "IDO completion passes a write of another stream");
+
+// Relaxed Ordering lets the relaxed TLP pass an earlier write, never a later TLP pass the relaxed write
+static_assert(ordering_may_pass({PCIeTLPType::MWr, PCIeAttrRelaxed, 1, 1, 0}, {PCIeTLPType::MWr, 0, 1, 1, 0}, true), "RO write passes a strict write");
+static_assert(!ordering_may_pass({PCIeTLPType::MWr, 0, 1, 1, 0}, {PCIeTLPType::MWr, PCIeAttrRelaxed, 1, 1, 0}, true), "strict write stays behind an RO write");
+static_assert(!ordering_may_pass({PCIeTLPType::MRd, PCIeAttrRelaxed, 1, 1, 0}, {PCIeTLPType::MWr, PCIeAttrRelaxed, 1, 1, 0}, true), "RO read stays behind an RO write");
@@ -0,0 +1,257 @@
+#pragma once
+#include <systemc>
+#include <tlm>
+#include <tlm_utils/simple_initiator_socket.h>
+#include <tlm_utils/simple_target_socket.h>
+#include <atomic>
+#include <vector>
+#include <sys/types.h>
+#include "log.hpp"
+#include "pcie_tlp_extension.hpp"
+#include "pcie_layers.hpp"
+
+using namespace sc_core;
+
+#define PartitionMaxCount       64      // processes, one SystemC kernel each
+#define PartitionMaxLinks       64      // requester / completer pairs, independent point-to-point links
+#define PartitionLookahead      LinkFlightTime  // ns, every timed message carries the link flight
+#ifndef PartitionSyncFactor
+#define PartitionSyncFactor     8       // sync window in lookaheads, 1 is exact; above it a message due inside
+                                        // the window it was sent in lands late, at the window end
+#endif
+#define PartitionChannelSlots   1024    // messages in flight per direction
+#define PartitionPayloadDW      16384   // payload DW in flight per direction
+#define PartitionMaxPayloadDW   1024    // Length field range
+#define PartitionPeerPoll       4096    // barrier spins between peer liveness checks
+#define PartitionRunTime        1000000 // ns, default run length, every partition stops at the same sync round
+
+// single producer single consumer ring, lives in memory shared by two processes
+//   producer: reserve() -> fill -> commit(), consumer: front() -> read -> pop()
+template <typename T, uint32_t N>
+struct PCIeSPSCChannel {
+    alignas(64) std::atomic<uint64_t> head;     // next slot to consume
+    alignas(64) std::atomic<uint64_t> tail;     // next slot to produce
+    alignas(64) uint64_t sealed[2];             // tail at the producer's barrier, by round parity so a fast producer never overwrites the one being read
+    T slots[N];
+
+    T* reserve() {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if ((t - head.load(std::memory_order_acquire)) >= N) {
+            return nullptr;
+        }
+        return &slots[t % N];
+    }
+
+    void commit() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    T* front(uint64_t limit) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h >= limit || h >= tail.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &slots[h % N];
+    }
+
+    void pop() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+};
+
+// payload ring beside a message ring, a message names its first DW; the consumer frees DWs as it pops messages
+template <uint32_t N>
+struct PCIeSPSCDataRing {
+    alignas(64) std::atomic<uint64_t> head;     // first DW the consumer still holds
+    alignas(64) uint64_t tail;                  // producer only, published by the message commit
+    PCIeTLPPayload data[N];
+
+    bool reserve(uint32_t length, uint64_t& offset) {
+        if ((tail + length - head.load(std::memory_order_acquire)) > N) {
+            return false;
+        }
+        offset = tail;
+        return true;
+    }
+
+    void commit(uint32_t length) {
+        tail += length;
+    }
+
+    void release(uint64_t end) {
+        head.store(end, std::memory_order_release);
+    }
+};
+
+// TLP or DLLP crossing the link, payload in the channel's payload ring
+struct PCIeLinkMessage {
+    uint64_t time;          // ps, delivery time at the receiver
+    uint8_t phase;          // BEGIN_REQ: TLP, BEGIN_RESP: DLLP
+    bool functional;        // sampling fast-forward, delivered through b_transport
+    PCIeTLPHeader header;
+    uint32_t seqNum;
+    bool relaxed;
+    bool no_snoop;
+    PCIeDLLPType dllp_type;
+    PCIeCreditType fc_type;
+    uint32_t fc;
+    uint32_t fc_header;
+    uint32_t vc;            // TLP: transmitter's VC, DLLP: VC of the UpdateFC
+    uint32_t length;
+    uint64_t offset;        // first payload DW in the payload ring
+};
+
+static_assert(PartitionPayloadDW >= PartitionMaxPayloadDW, "payload ring holds the longest TLP");
+
+// one direction of a link
+struct PCIeLinkChannel {
+    PCIeSPSCChannel<PCIeLinkMessage, PartitionChannelSlots> messages;
+    PCIeSPSCDataRing<PartitionPayloadDW> payloads;
+};
+
+// two-party barrier between the ends of one link, sense by generation
+struct PCIeLinkBarrier {
+    alignas(64) std::atomic<uint32_t> arrived;
+    alignas(64) std::atomic<uint32_t> generation;
+};
+
+// topology: link l joins requester end 2l and completer end 2l+1, end e lives in partition e % partitionCount;
+// a link whose ends share a partition is bound directly and never crosses shared memory
+struct PCIePartitionTopology {
+    uint32_t linkCount;
+    uint32_t partitionCount;
+
+    uint32_t partition_of(uint32_t link, uint32_t side) const { return ((2 * link) + side) % partitionCount; }
+};
+
+// header of the shared mapping, followed by one channel per directed link and one barrier per link
+struct alignas(64) PCIePartitionShared {
+    PCIePartitionTopology topology;
+    pid_t pid[PartitionMaxCount];
+
+    // channel(l, side) is produced by that end of link l
+    PCIeLinkChannel& channel(uint32_t link, uint32_t side) {
+        return reinterpret_cast<PCIeLinkChannel*>(this + 1)[(2 * link) + side];
+    }
+    PCIeLinkBarrier& barrier(uint32_t link) {
+        PCIeLinkChannel *channels = reinterpret_cast<PCIeLinkChannel*>(this + 1);
+        return reinterpret_cast<PCIeLinkBarrier*>(channels + (2 * topology.linkCount))[link];
+    }
+};
+
+// map the shared link state and fork one process per partition, called before elaboration
+PCIePartitionShared* create_partition_shared(const PCIePartitionTopology& topology);
+int fork_partitions(PCIePartitionShared *shared);
+void join_partitions(PCIePartitionShared *shared);
+
+// stands in for the link partner's data link layer on the other side of a partition boundary,
+// one per crossing link end; sends go to this end's channel, the partition drains the peer's
+class PCIeLinkProxy
+: sc_core::sc_module,
+  public tlm::tlm_fw_transport_if<>,
+  public tlm::tlm_bw_transport_if<>
+{
+public:
+    PCIeLinkProxy(sc_core::sc_module_name name, PCIePartitionShared *shared_, int id_, uint32_t link_, uint32_t side_)
+    : sc_core::sc_module(name),
+      s_in("link_proxy_rx"),
+      s_out("link_proxy_tx"),
+      shared(shared_),
+      id(id_),
+      link(link_),
+      side(side_),
+      round(0)
+    {
+        s_in.register_nb_transport_fw(this, &PCIeLinkProxy::nb_transport_fw);
+        s_in.register_b_transport(this, &PCIeLinkProxy::b_transport);
+        s_out.register_nb_transport_bw(this, &PCIeLinkProxy::nb_transport_bw);
+
+        // profiling
+        profile_tx_count = 0;
+        profile_rx_count = 0;
+        profile_late_count = 0;
+        profile_max_late = 0;
+
+        SC_LOG(INFO, "init done: partition=%d, link=%d, peer=%d", id, link, peer());
+    }
+
+    // TLM component
+    tlm_utils::simple_target_socket<PCIeLinkProxy> s_in;        // bound by the local DLL s_out
+    tlm_utils::simple_initiator_socket<PCIeLinkProxy> s_out;    // bound to the local DLL s_in
+
+    uint32_t get_link() const { return link; }
+    void seal(uint64_t round_);
+    void exchange();
+    void report_stats();
+
+private:
+
+    // -- component
+    PCIePartitionShared *shared;
+    int id;
+    uint32_t link;
+    uint32_t side;
+    uint64_t round;
+
+    // -- function
+    int peer() const { return shared->topology.partition_of(link, side ^ 1); }
+    void barrier();
+    bool peer_is_gone();
+    void send(tlm::tlm_generic_payload& trans, const tlm::tlm_phase& phase, const sc_core::sc_time& delay, bool functional);
+    void deliver(const PCIeLinkMessage& message, const PCIeSPSCDataRing<PartitionPayloadDW>& payloads);
+
+    // tlm_fw/bw_transport_if override function
+    tlm::tlm_sync_enum nb_transport_fw(tlm::tlm_generic_payload& trans, tlm::tlm_phase& phase, sc_core::sc_time& delay);
+    tlm::tlm_sync_enum nb_transport_bw(tlm::tlm_generic_payload& trans, tlm::tlm_phase& phase, sc_core::sc_time& delay);
+    void b_transport(tlm::tlm_generic_payload& trans, sc_core::sc_time& delay);
+    bool get_direct_mem_ptr(tlm::tlm_generic_payload& trans, tlm::tlm_dmi& dmi_data);
+    unsigned int transport_dbg(tlm::tlm_generic_payload& trans);
+    void invalidate_direct_mem_ptr(sc_dt::uint64 start_range, sc_dt::uint64 end_range);
+
+    // -- profile
+    uint64_t profile_tx_count;
+    uint64_t profile_rx_count;
+    uint64_t profile_late_count;
+    double profile_max_late;
+
+};
+
+// one per process, synchronizes only with the partitions its links reach
+//   conservative synchronization: every PartitionSyncFactor lookaheads each crossing link meets at its own barrier,
+//   every timed message carries at least the link flight time; a message due after the window end keeps its time,
+//   one due before it (only with PartitionSyncFactor > 1) is delivered late at the window end and counted;
+//   links are visited in global link order, so no two partitions can wait on each other in a cycle
+class PCIePartition
+: sc_core::sc_module
+{
+public:
+    PCIePartition(sc_core::sc_module_name name, int id_, sc_core::sc_time run_time_)
+    : sc_core::sc_module(name),
+      id(id_),
+      round(0),
+      runTime(run_time_)
+    {
+        profile_sync_count = 0;
+
+        SC_THREAD(process_sync);
+        SC_LOG(INFO, "init done: partition=%d, lookahead=%d ns, window=%d ns", id, PartitionLookahead, PartitionLookahead * PartitionSyncFactor);
+    }
+
+    void add_proxy(PCIeLinkProxy *proxy);
+    void report_stats();
+
+private:
+
+    // -- component
+    int id;
+    uint64_t round;
+    sc_core::sc_time runTime;
+    std::vector<PCIeLinkProxy*> proxies;    // by link
+
+    // -- function
+    void process_sync();
+
+    // -- profile
+    uint64_t profile_sync_count;
+
+};
@@ -0,0 +1,242 @@
+#pragma once
+#include <systemc>
+#include <tlm>
+#include <map>
+#include <memory>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// sc_spawn has to be enabled before the first <systemc>, so it comes from the build flags
+#ifndef SC_INCLUDE_DYNAMIC_PROCESSES
+#error "PCIeWheelPEQ needs SC_INCLUDE_DYNAMIC_PROCESSES, see CXXFLAGS in the Makefile"
+#endif
+
+#define PCIePEQWheelSlots       64      // one bit per slot in the occupancy mask
+#define PCIePEQWheelResolution  1       // ns per slot, link delays are whole ns
+#define PCIePEQNodeChunk        256     // nodes allocated at once when the free list runs dry
+
+enum class PCIePEQType {
+    Stock,      // tlm_utils::peq_with_cb_and_phase
+    Wheel,      // PCIeWheelPEQ
+};
+
+// index of the lowest set bit, mask is non-zero
+inline uint32_t pcie_ctz64(uint64_t mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(mask);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return index;
+#else
+    uint32_t index = 0;
+    while ((mask & 1) == 0) {
+        mask >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+// timing wheel payload event queue, drop-in for peq_with_cb_and_phase
+//   entries fire in time order and in notify order for the same time,
+//   a zero delay notify fires in the next delta cycle
+//   nodes are intrusive and recycled, entries beyond the wheel go to an overflow map
+template <typename OWNER>
+class PCIeWheelPEQ {
+public:
+    typedef void (OWNER::*cb)(tlm::tlm_generic_payload&, const tlm::tlm_phase&);
+
+    PCIeWheelPEQ(OWNER *owner, cb callback)
+    : m_owner(owner),
+      m_callback(callback),
+      resolution(sc_core::sc_time(PCIePEQWheelResolution, sc_core::SC_NS).value()),
+      occupancy(0),
+      nextSeq(0),
+      freeList(nullptr),
+      pending(false)
+    {
+        static_assert(PCIePEQWheelSlots == 64, "occupancy mask holds 64 slots");
+        for (uint32_t i = 0; i < PCIePEQWheelSlots; i++) {
+            bucketHead[i] = nullptr;
+            bucketTail[i] = nullptr;
+        }
+
+        sc_core::sc_spawn_options opts;
+        opts.spawn_method();
+        opts.set_sensitivity(&m_event);
+        opts.dont_initialize();
+        sc_core::sc_spawn([this]() { fire(); }, sc_core::sc_gen_unique_name("pcie_wheel_peq"), &opts);
+    }
+
+    void notify(tlm::tlm_generic_payload& trans, const tlm::tlm_phase& phase, const sc_core::sc_time& delay) {
+        migrate_overflow();
+
+        Node *node = alloc_node();
+        node->trans = &trans;
+        node->phase = phase;
+        node->time = sc_core::sc_time_stamp() + delay;
+        node->seq = nextSeq++;
+        node->next = nullptr;
+
+        if ((slot(node->time) - slot(sc_core::sc_time_stamp())) < PCIePEQWheelSlots) {
+            insert_bucket(node);
+        }
+        else {
+            overflow.insert(std::make_pair(node->time, node));
+        }
+        schedule(node->time);
+    }
+
+    void notify(tlm::tlm_generic_payload& trans, const tlm::tlm_phase& phase) {
+        notify(trans, phase, sc_core::SC_ZERO_TIME);
+    }
+
+    void cancel_all() {
+        for (uint32_t i = 0; i < PCIePEQWheelSlots; i++) {
+            while (bucketHead[i] != nullptr) {
+                Node *node = bucketHead[i];
+                bucketHead[i] = node->next;
+                free_node(node);
+            }
+            bucketTail[i] = nullptr;
+        }
+        for (auto& entry : overflow) {
+            free_node(entry.second);
+        }
+        overflow.clear();
+        occupancy = 0;
+        m_event.cancel();
+        pending = false;
+    }
+
+private:
+    struct Node {
+        tlm::tlm_generic_payload *trans;
+        tlm::tlm_phase phase;
+        sc_core::sc_time time;
+        uint64_t seq;
+        Node *next;
+    };
+
+    OWNER *m_owner;
+    cb m_callback;
+    uint64_t resolution;
+    Node *bucketHead[PCIePEQWheelSlots];
+    Node *bucketTail[PCIePEQWheelSlots];
+    uint64_t occupancy;
+    std::multimap<sc_core::sc_time, Node*> overflow;
+    uint64_t nextSeq;
+    Node *freeList;
+    std::vector<std::unique_ptr<Node[]>> chunks;
+    sc_core::sc_event m_event;
+    sc_core::sc_time scheduled;
+    bool pending;
+
+    uint64_t slot(const sc_core::sc_time& time) const {
+        return time.value() / resolution;
+    }
+
+    Node* alloc_node() {
+        if (freeList == nullptr) {
+            chunks.emplace_back(new Node[PCIePEQNodeChunk]);
+            Node *chunk = chunks.back().get();
+            for (uint32_t i = 0; i < PCIePEQNodeChunk; i++) {
+                chunk[i].next = freeList;
+                freeList = &chunk[i];
+            }
+        }
+        Node *node = freeList;
+        freeList = node->next;
+        return node;
+    }
+
+    void free_node(Node *node) {
+        node->next = freeList;
+        freeList = node;
+    }
+
+    // keep bucket sorted by time, equal time stays in notify order
+    void insert_bucket(Node *node) {
+        uint32_t b = slot(node->time) % PCIePEQWheelSlots;
+        occupancy |= (1ULL << b);
+
+        if (bucketTail[b] == nullptr) {
+            bucketHead[b] = node;
+            bucketTail[b] = node;
+        }
+        else if (bucketTail[b]->time <= node->time) {
+            bucketTail[b]->next = node;
+            bucketTail[b] = node;
+        }
+        else if (node->time < bucketHead[b]->time) {
+            node->next = bucketHead[b];
+            bucketHead[b] = node;
+        }
+        else {
+            Node *prev = bucketHead[b];
+            while (prev->next->time <= node->time) {
+                prev = prev->next;
+            }
+            node->next = prev->next;
+            prev->next = node;
+        }
+    }
+
+    // move entries that came within the wheel's span, they always precede later notifies at the same time
+    void migrate_overflow() {
+        uint64_t base = slot(sc_core::sc_time_stamp());
+        while (!overflow.empty() && (slot(overflow.begin()->first) - base) < PCIePEQWheelSlots) {
+            Node *node = overflow.begin()->second;
+            overflow.erase(overflow.begin());
+            insert_bucket(node);
+        }
+    }
+
+    void schedule(const sc_core::sc_time& time) {
+        if (pending && scheduled <= time) {
+            return;
+        }
+        pending = true;
+        scheduled = time;
+        m_event.notify(time - sc_core::sc_time_stamp());
+    }
+
+    void fire() {
+        sc_core::sc_time now = sc_core::sc_time_stamp();
+        if (pending && scheduled <= now) {
+            pending = false;
+        }
+        migrate_overflow();
+
+        // entries notified during this evaluation wait for the next delta
+        uint64_t limit = nextSeq;
+        uint32_t b = slot(now) % PCIePEQWheelSlots;
+        while (bucketHead[b] != nullptr && bucketHead[b]->time <= now && bucketHead[b]->seq < limit) {
+            Node *node = bucketHead[b];
+            bucketHead[b] = node->next;
+            if (bucketHead[b] == nullptr) {
+                bucketTail[b] = nullptr;
+                occupancy &= ~(1ULL << b);
+            }
+
+            tlm::tlm_generic_payload *trans = node->trans;
+            tlm::tlm_phase phase = node->phase;
+            free_node(node);
+            (m_owner->*m_callback)(*trans, phase);
+        }
+
+        // earliest entry is the head of the first occupied slot from now on
+        if (occupancy != 0) {
+            uint64_t rotate = (b == 0) ? occupancy : ((occupancy >> b) | (occupancy << (PCIePEQWheelSlots - b)));
+            uint32_t next = (b + pcie_ctz64(rotate)) % PCIePEQWheelSlots;
+            schedule(bucketHead[next]->time);
+        }
+        else if (!overflow.empty()) {
+            schedule(overflow.begin()->first);
+        }
+    }
+};
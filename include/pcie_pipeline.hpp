@@ -0,0 +1,72 @@
+#pragma once
+#include <systemc>
+#include <algorithm>
+#include <cstdint>
+
+// clocked controller pipeline of one layer
+//   a TLP of n DW enters on a clock edge once the previous one's last beat went in,
+//   takes ceil(n / width) cycles to enter and leaves stages - 1 cycles after its last beat
+//   zero stages is a zero-time layer
+class PCIePipeline {
+public:
+    PCIePipeline(double clock_mhz, uint32_t stages_, uint32_t width_)
+    : period(sc_core::sc_time(1000.0 / clock_mhz, sc_core::SC_NS)),
+      stages(stages_),
+      width(std::max<uint32_t>(width_, 1)),
+      busy(sc_core::SC_ZERO_TIME)
+    {
+        profile_count = 0;
+        profile_occupancy = 0;
+        profile_stall = 0;
+        profile_latency = 0;
+    }
+
+    // enter at start, returns when the TLP leaves the last stage; issued is when the next one may enter
+    sc_core::sc_time pass(const sc_core::sc_time& start, uint32_t lengthDW, sc_core::sc_time *issued = nullptr) {
+        if (stages == 0) {
+            if (issued != nullptr) {
+                *issued = start;
+            }
+            return start;
+        }
+
+        uint64_t beats = std::max<uint64_t>((lengthDW + width - 1) / width, 1);
+        sc_core::sc_time begin = std::max(edge(start), busy);
+        busy = begin + (period * static_cast<double>(beats));
+        sc_core::sc_time leave = busy + (period * static_cast<double>(stages - 1));
+        if (issued != nullptr) {
+            *issued = busy;
+        }
+
+        // profiling
+        profile_count++;
+        profile_occupancy += (busy - begin).to_seconds();
+        profile_stall += (begin - start).to_seconds();
+        profile_latency += (leave - start).to_seconds();
+        return leave;
+    }
+
+    // fixed work, e.g. one DLLP, next to the datapath
+    sc_core::sc_time cycles(uint32_t count) const {
+        return (stages == 0) ? sc_core::SC_ZERO_TIME : period * static_cast<double>(count);
+    }
+
+    bool enabled() const { return stages > 0; }
+
+    // -- profile
+    uint64_t profile_count;
+    double profile_occupancy;
+    double profile_stall;
+    double profile_latency;
+
+private:
+    sc_core::sc_time period;
+    uint32_t stages;
+    uint32_t width;
+    sc_core::sc_time busy;      // first stage taken until
+
+    sc_core::sc_time edge(const sc_core::sc_time& time) const {
+        uint64_t ticks = (time.value() + period.value() - 1) / period.value();
+        return period * static_cast<double>(ticks);
+    }
+};
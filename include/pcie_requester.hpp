@@ -3,9 +3,23 @@
 #include <unordered_map>
 #include "log.hpp"
 #include "pcie_layers.hpp"
+#include "pcie_dma.hpp"
+#include "pcie_write_combiner.hpp"
 
 using namespace sc_core;
 
+#define RequesterTrafficRandom  0   // random 1~64 DW MWr
+#define RequesterTrafficDMA     1   // descriptor ring driven DMA engine
+#ifndef RequesterTrafficMode
+#define RequesterTrafficMode    RequesterTrafficRandom
+#endif
+#define RequesterIssueInterval      5       // random traffic, ns between writes
+#define RequesterMinDW              1       // random traffic, uniform write length
+#define RequesterMaxDW              64
+#define RequesterSequentialPercent  75      // random traffic, writes that follow on from the previous one
+#define RequesterAddressSpace       0x100000    // random traffic, jump target range
+#define RequesterFenceInterval      1000    // random traffic, writes between fences, 0 never
+
 class PCIeRequester_
 : sc_core::sc_module
 {
@@ -13,15 +27,29 @@ public:
     PCIeRequester_(sc_core::sc_module_name name, unsigned int id)
     : sc_core::sc_module(name),
       requesterID(id),
-      rand(1, 64)
+      rand(RequesterMinDW, RequesterMaxDW),
+      randAddress(0, 99)
     {
+#if RequesterTrafficMode == RequesterTrafficRandom
         SC_THREAD(process_send_command);
+#endif
 
         m_dataLinkLayer = new PCIeDataLinkLayer("dataLinkLayer", requesterID);
         m_transactionLayer = new PCIeTransactionLayer("transactionLayer", requesterID, m_dataLinkLayer);
         m_dataLinkLayer->m_transactionLayer = m_transactionLayer;
+        m_atc = new PCIeATC("atc", m_transactionLayer);
+        m_dmaEngine = new PCIeDMAEngine("dmaEngine", requesterID, m_transactionLayer, m_atc);
+        m_writeCombiner = new PCIeWriteCombiner("writeCombiner", m_transactionLayer);
+        m_transactionLayer->register_receive_TLP([this](const PCIeTLPHeader& header, std::vector<PCIeTLPPayload>* payloads) {
+            return receive_TLP(header, payloads);
+        });
 
         // profiling
+        sendCount = 0;
+        sendLength = 0;
+        sendAddress = 0;
+        generatorPaused = false;
+        generatorParked = false;
         profile_write_byte_size = 0;
         profile_read_byte_size = 0;
 
@@ -35,16 +63,38 @@ public:
     //  public function can be used by other
     //  ====================================
     void process_send_command();
+    sc_core::sc_time receive_TLP(const PCIeTLPHeader& header, std::vector<PCIeTLPPayload>* payloads);
+    void save(CheckpointWriter& writer);
+    bool restore(CheckpointReader& reader);
+
+    // sampling, random traffic of a fast-forward interval is issued at once
+    void pause_generator();
+    void resume_generator();
+    bool drain();
+    void fast_forward(sc_core::sc_time duration);
 
     PCIeTransactionLayer *m_transactionLayer;
     PCIeDataLinkLayer *m_dataLinkLayer;
+    PCIeDMAEngine *m_dmaEngine;
+    PCIeATC *m_atc;
+    PCIeWriteCombiner *m_writeCombiner;
 
 private:
 
     // -- component
     Randomizer rand;
+    Randomizer randAddress;
+    uint32_t sendCount;
+    uint32_t sendLength;    // TLP waiting for the transaction layer, 0 when none
+    uint64_t sendAddress;
+    sc_core::sc_time start_time;
+    bool generatorPaused;
+    bool generatorParked;
+    sc_core::sc_event event_generatorResume;
 
     // -- function
+    std::vector<PCIeTLPPayload>* next_write();
+    void retire_write(std::vector<PCIeTLPPayload>* payloads);
 
     // -- profile
     double profile_write_byte_size, profile_write_throughput;
@@ -0,0 +1,84 @@
+#pragma once
+#include <systemc>
+#include <cmath>
+#include "log.hpp"
+#include "pcie_requester.hpp"
+#include "pcie_completer.hpp"
+
+using namespace sc_core;
+
+#ifndef SamplingEnable
+#define SamplingEnable          0       // alternate fast-forward and detailed windows
+#endif
+#define SamplingFastForward     100000  // ns, functional between two samples
+#define SamplingWarmup          2000    // ns, detailed but discarded after a fast-forward
+#define SamplingWindow          10000   // ns, detailed and measured
+#define SamplingConfidenceZ     1.96    // 95% two-sided, normal approximation
+#define SamplingReportInterval  10      // samples
+#define SamplingDrainPoll       10      // ns, link idle check before a fast-forward
+
+// running mean and confidence interval of one metric over sample windows
+class SampleStat {
+public:
+    SampleStat() : count(0), sum(0), sum_sq(0) {}
+
+    void add(double value) {
+        count++;
+        sum += value;
+        sum_sq += value * value;
+    }
+
+    uint64_t size() const { return count; }
+    double mean() const { return (count > 0) ? sum / count : 0; }
+
+    // half width of the confidence interval
+    double interval() const {
+        if (count < 2) {
+            return 0;
+        }
+        double variance = (sum_sq - (sum * sum) / count) / (count - 1);
+        return SamplingConfidenceZ * std::sqrt(std::max(variance, 0.0) / count);
+    }
+
+private:
+    uint64_t count;
+    double sum, sum_sq;
+};
+
+// switches the requester and completer stack between fast-forward, where TLPs
+// are delivered functionally without link timing, and detailed windows
+class PCIeSamplingController
+: sc_core::sc_module
+{
+public:
+    PCIeSamplingController(sc_core::sc_module_name name, PCIeRequester_ *m_requester_, PCIeCompleter_ *m_completer_)
+    : sc_core::sc_module(name),
+      m_requester(m_requester_),
+      m_completer(m_completer_)
+    {
+        SC_THREAD(process_sample);
+        SC_LOG(INFO, "init done");
+    }
+
+private:
+
+    struct Snapshot {
+        uint64_t tlp_count;
+        double byte_size;
+        double latency;
+    };
+
+    // -- component
+    PCIeRequester_ *m_requester;
+    PCIeCompleter_ *m_completer;
+    SampleStat throughput;  // GB/s
+    SampleStat latency;     // ns
+
+    // -- function
+    void process_sample();
+    void set_functional(bool enable);
+    bool drain();
+    void fast_forward();
+    Snapshot take_snapshot();
+
+};
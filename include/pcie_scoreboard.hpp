@@ -0,0 +1,79 @@
+#pragma once
+#include <systemc>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include "log.hpp"
+#include "pcie_tlp_extension.hpp"
+
+using namespace sc_core;
+
+class PCIeDataLinkLayer;
+
+#ifndef ScoreboardEnable
+#define ScoreboardEnable          1
+#endif
+#define ScoreboardStopOnMismatch  1     // end the simulation at the first corrupted TLP
+#define ScoreboardDumpDW          8     // received DWs printed with a mismatch
+
+// Fletcher-64 over DWs, position sensitive and updated one DW at a time
+struct PCIeChecksum {
+    uint64_t sum0 = 0;
+    uint64_t sum1 = 0;
+
+    void add(uint32_t dw) {
+        sum0 = (sum0 + dw) % 0xFFFFFFFF;
+        sum1 = (sum1 + sum0) % 0xFFFFFFFF;
+    }
+
+    uint64_t value() const { return (sum1 << 32) | sum0; }
+};
+
+// end-to-end payload check, the checksum taken when a TLP is submitted to the
+// transaction layer is matched against the payload the link partner receives
+//   only TLPs on the wire are tracked, keyed by sender and seqNum
+class PCIeScoreboard
+: sc_core::sc_module
+{
+public:
+    PCIeScoreboard(sc_core::sc_module_name name)
+    : sc_core::sc_module(name)
+    {
+        // profiling
+        profile_tlp_count = 0;
+        profile_dw_count = 0;
+        profile_mismatch_count = 0;
+
+        SC_LOG(INFO, "init done");
+    }
+
+    //  ====================================
+    //  public function can be used by other
+    //  ====================================
+    void connect(PCIeDataLinkLayer *a, PCIeDataLinkLayer *b);
+    void expect(PCIeDataLinkLayer *sender, uint32_t seqNum, const PCIeTLPHeader& header, uint32_t length, uint64_t checksum);
+    bool check(PCIeDataLinkLayer *receiver, uint32_t seqNum, const PCIeTLPHeader& header, const std::vector<PCIeTLPPayload>* payloads);
+    void report_stats();
+
+private:
+
+    struct Expected {
+        PCIeTLPHeader header;
+        uint32_t length;
+        uint64_t checksum;
+        sc_core::sc_time timestamp;
+    };
+
+    // -- component
+    std::map<PCIeDataLinkLayer*, PCIeDataLinkLayer*> peer;  // receiver -> sender
+    std::map<PCIeDataLinkLayer*, std::unordered_map<uint32_t, Expected>> inflight;
+
+    // -- function
+    void report_mismatch(const char *reason, uint32_t seqNum, const Expected& expected, const PCIeTLPHeader& header, const std::vector<PCIeTLPPayload>* payloads, uint64_t checksum);
+
+    // -- profile
+    uint64_t profile_tlp_count;
+    uint64_t profile_dw_count;
+    uint64_t profile_mismatch_count;
+
+};
@@ -0,0 +1,84 @@
+#pragma once
+#include <systemc>
+#include <array>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "log.hpp"
+#include "pcie_layers.hpp"
+
+#define SizingRunTime         200000    // ns simulated per point
+#define SizingMaxPass         4         // coordinate search passes over all resources
+#define SizingCachePrefix     "sizing."   // cache file per build: sizing.<executable hash>.cache
+#define SizingTagEntryByte    8         // outstanding request table entry
+#define PCIeTLPHeaderByte     16
+
+enum class SizingResource {
+    InternalBuffer,
+    ReplayBuffer,
+    Tag,
+    Credit,
+    Count,
+};
+
+struct PCIeSizingResult {
+    double throughput;      // GB/s
+    double p99_latency;     // ns
+    double mean_latency;    // ns, not cached
+};
+
+// one simulation with the given resources in a forked child, a child that died leaves the point unreachable
+PCIeSizingResult pcie_simulate_forked(const std::function<PCIeSizingResult()>& simulate, const PCIeResourceConfig& config);
+uint64_t pcie_resource_area(const PCIeResourceConfig& config);
+
+// smallest TL / DLL resources that still reach a throughput and p99 latency target,
+// every point is one simulation in a forked child so each run elaborates a fresh model
+//   search: coordinate bisection over power of two sizes, starting from the macro defaults
+//   cache: results are kept per build, keyed by a hash of the executable, and reused for the same workload and run time
+class PCIeSizingSearch
+{
+public:
+    PCIeSizingSearch(std::function<PCIeSizingResult()> simulate_, const std::string& workload_, double target_throughput_, double target_latency_)
+    : simulate(simulate_),
+      workload(workload_),
+      target_throughput(target_throughput_),
+      target_latency(target_latency_)
+    {
+        profile_run_count = 0;
+        profile_cache_hit = 0;
+    }
+
+    //  ====================================
+    //  public function can be used by other
+    //  ====================================
+    PCIeResourceConfig run();
+    void report_frontier();
+    const char* name() const { return "Sizing"; }
+
+private:
+
+    typedef std::array<uint32_t, static_cast<int>(SizingResource::Count)> SizingKey;
+
+    // -- component
+    std::function<PCIeSizingResult()> simulate;
+    std::string workload;
+    double target_throughput;
+    double target_latency;
+    std::map<SizingKey, PCIeSizingResult> results;
+    std::string cachePath;
+
+    // -- function
+    PCIeSizingResult evaluate(const SizingKey& key);
+    bool meets_target(const PCIeSizingResult& result);
+    uint64_t get_area(const SizingKey& key);
+    PCIeResourceConfig get_config(const SizingKey& key);
+    std::string get_cache_path();
+    void load_cache();
+    void save_cache(const SizingKey& key, const PCIeSizingResult& result);
+
+    // -- profile
+    uint64_t profile_run_count;
+    uint64_t profile_cache_hit;
+
+};
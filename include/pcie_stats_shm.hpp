@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// live statistics segment shared between a running simulation and the stats viewer,
+// one writer, any number of readers, seqlock protected, no SystemC dependency
+#define LiveStatsShmPrefix    "/pcie_live_stats."   // + pid
+#define LiveStatsMagic        0x50534C56            // "PSLV"
+#define LiveStatsVersion      1
+
+struct PCIeLiveStatsData {
+    double sim_time;            // ns
+    double wall_time;           // s since elaboration
+    double throughput;          // GB/s, requester transaction layer
+    uint64_t progress;          // TLPs submitted plus completions received
+    uint32_t unacked;           // TLPs in the replay buffer waiting for Ack
+    uint32_t outstanding_np;    // non-posted requests waiting for completion
+    uint32_t credit_header[3];  // requester vc0, P / NP / Cpl
+    uint32_t credit_payload[3];
+    uint32_t replay_header_used;
+    uint32_t replay_payload_used;
+    uint32_t replay_size;
+    uint32_t internal_used;     // DW, all VCs
+    uint32_t internal_size;
+    uint32_t done;
+};
+
+struct PCIeLiveStatsShm {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t pid;
+    std::atomic<uint64_t> seq;  // odd while the writer is in the middle of an update
+    PCIeLiveStatsData data;
+
+    void publish(const PCIeLiveStatsData& update) {
+        uint64_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&data, &update, sizeof(data));
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    // false when the writer kept updating for every try
+    bool snapshot(PCIeLiveStatsData& out) const {
+        for (int retry = 0; retry < 1000; retry++) {
+            uint64_t before = seq.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            std::memcpy(&out, &data, sizeof(out));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed) == before) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
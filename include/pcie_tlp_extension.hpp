@@ -19,6 +19,48 @@ enum class PCIeTLPType {
     // ...etc
 };
 
+constexpr bool is_posted(PCIeTLPType type) {
+    return (type == PCIeTLPType::MWr || type == PCIeTLPType::Msg || type == PCIeTLPType::MsgD);
+}
+
+constexpr bool is_completion(PCIeTLPType type) {
+    return (type == PCIeTLPType::Cpl || type == PCIeTLPType::CplD);
+}
+
+constexpr bool is_non_posted(PCIeTLPType type) {
+    return (!is_posted(type) && !is_completion(type));
+}
+
+enum class PCIeCreditType {
+    Posted     = 0,
+    NonPosted  = 1,
+    Completion = 2,
+};
+#define PCIeCreditTypeCount   3
+
+inline PCIeCreditType get_credit_type(PCIeTLPType type) {
+    if (is_posted(type)) {
+        return PCIeCreditType::Posted;
+    }
+    return is_completion(type) ? PCIeCreditType::Completion : PCIeCreditType::NonPosted;
+}
+
+// address type (AT field)
+#define PCIeATUntranslated    0x0
+#define PCIeATTranslationReq  0x1
+#define PCIeATTranslated      0x2
+
+// message code, carried in DW0 of MsgD payload
+enum class PCIeMsgCode {
+    ATSInvalidateRequest    = 0x01,
+    ATSInvalidateCompletion = 0x02,
+};
+
+// TLP attributes, Attr0 = {RO, NS}, Attr1 = IDO
+#define PCIeAttrNoSnoop       0x1
+#define PCIeAttrRelaxed       0x2
+#define PCIeAttrIDO           0x4
+
 enum class PCIeDLLPType {
     AckNack  = 2,
     UpdateFC = 5,
@@ -54,11 +96,35 @@ struct PCIeTLPHeader {
     uint32_t DWBE_last  :4;
     uint32_t tag        :8;
     uint32_t reqID      :16;
+    uint32_t cplID      :16;    // completion only
     uint32_t Addr_h     :32;
     uint32_t Rsv3       :2;
     uint32_t Addr_l     :30;
 };
 
+inline void set_tlp_address(PCIeTLPHeader& header, uint64_t address) {
+    header.Addr_h = static_cast<uint32_t>(address >> 32);
+    header.Addr_l = static_cast<uint32_t>((address >> 2) & 0x3FFFFFFF);
+}
+
+inline uint64_t get_tlp_address(const PCIeTLPHeader& header) {
+    return (static_cast<uint64_t>(header.Addr_h) << 32) | (static_cast<uint64_t>(header.Addr_l) << 2);
+}
+
+inline void set_tlp_attr(PCIeTLPHeader& header, uint8_t attr) {
+    header.Attr0 = attr & (PCIeAttrNoSnoop | PCIeAttrRelaxed);
+    header.Attr1 = (attr & PCIeAttrIDO) ? 1 : 0;
+}
+
+inline uint8_t get_tlp_attr(const PCIeTLPHeader& header) {
+    return header.Attr0 | (header.Attr1 ? PCIeAttrIDO : 0);
+}
+
+// ID-Based Ordering stream, the completer ID of a completion, the requester ID otherwise
+inline uint16_t get_tlp_stream_id(const PCIeTLPHeader& header) {
+    return is_completion(static_cast<PCIeTLPType>(header.Type)) ? header.cplID : header.reqID;
+}
+
 struct PCIeTLPPayload {
     uint32_t payload;
 };
@@ -101,6 +167,7 @@ struct PCIeTLPExtension : tlm::tlm_extension<PCIeTLPExtension> {
     PCIeTLP tlp;
     PCIeTLPType tlp_type = PCIeTLPType::MRd;
     uint8_t   tag        = 0;
+    uint8_t   vc         = 0;   // transmitter's VC, the receiver holds and returns credits on it
     uint8_t   lengthDW   = 0;
     PCIeTLPHeader header;
     std::vector<PCIeTLPPayload> *payloads;
@@ -129,7 +196,9 @@ struct PCIeDLLPExtension : tlm::tlm_extension<PCIeDLLPExtension> {
     PCIeDLLP dllp;
     uint32_t seqNum;
     uint32_t fc;
+    uint32_t fc_header = 1;
     PCIeDLLPType dllp_type = PCIeDLLPType::AckNack;
+    PCIeCreditType fc_type = PCIeCreditType::Posted;
     PCIeRequesterID requester;
     PCIeCompleterID completer;
     sc_core::sc_time timestamp;
@@ -0,0 +1,59 @@
+#pragma once
+#include <systemc>
+#include <string>
+#include <vector>
+#include "log.hpp"
+#include "pcie_requester.hpp"
+#include "pcie_completer.hpp"
+#include "pcie_checkpoint.hpp"
+
+using namespace sc_core;
+
+#define WatchdogActionStop        0     // dump and end the simulation
+#define WatchdogActionCheckpoint  1     // dump, write the stalled state to WatchdogCheckpointPath, end
+#ifndef WatchdogEnable
+#define WatchdogEnable            1
+#endif
+#ifndef WatchdogWindow
+#define WatchdogWindow            100000    // ns without forward progress while work is pending
+#endif
+#ifndef WatchdogAction
+#define WatchdogAction            WatchdogActionStop
+#endif
+#define WatchdogCheckpointPath    "stall.ckpt"
+
+// flags a layer that has work pending but made no forward progress for a whole window,
+// e.g. credits or Acks that never come back, and dumps every resource it may be blocked on
+class PCIeWatchdog
+: sc_core::sc_module
+{
+public:
+    PCIeWatchdog(sc_core::sc_module_name name, PCIeRequester_ *m_requester_, PCIeCompleter_ *m_completer_, PCIeCheckpointController *m_checkpoint_)
+    : sc_core::sc_module(name),
+      m_requester(m_requester_),
+      m_completer(m_completer_),
+      m_checkpoint(m_checkpoint_)
+    {
+        SC_THREAD(process_watch);
+        SC_LOG(INFO, "init done: window=%d ns", WatchdogWindow);
+    }
+
+private:
+
+    struct LayerProgress {
+        const char *name;
+        uint64_t progress;
+        bool pending;
+    };
+
+    // -- component
+    PCIeRequester_ *m_requester;
+    PCIeCompleter_ *m_completer;
+    PCIeCheckpointController *m_checkpoint;
+
+    // -- function
+    void process_watch();
+    std::vector<LayerProgress> take_snapshot();
+    void dump_state();
+
+};
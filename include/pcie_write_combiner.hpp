@@ -0,0 +1,80 @@
+#pragma once
+#include <systemc>
+#include <vector>
+#include "log.hpp"
+#include "pcie_layers.hpp"
+#include "checkpoint.hpp"
+
+using namespace sc_core;
+
+#ifndef WriteCombineEnable
+#define WriteCombineEnable    0
+#endif
+#ifndef WriteCombineTimeout
+#define WriteCombineTimeout   20    // ns an open buffer waits for a contiguous write
+#endif
+#define PCIeTLPOverheadByte   24    // STP / seqNum 4, 4DW header 16, LCRC 4
+
+enum class WriteCombineFlush {
+    Full,           // reached MPS
+    Discontiguous,  // next write does not follow on
+    Boundary,       // next write starts or ends on another 4 KB page
+    Timeout,
+    Fence,
+    Count,
+};
+
+// write-combining buffer in front of PCIeTransactionLayer::send_TLP(),
+// address-contiguous MWr are merged into one TLP of at most MPS that stays within a 4 KB page;
+// disabled, each write passes through, split in two when it crosses a page
+class PCIeWriteCombiner
+: sc_core::sc_module
+{
+public:
+    PCIeWriteCombiner(sc_core::sc_module_name name, PCIeTransactionLayer *m_transactionLayer_)
+    : sc_core::sc_module(name),
+      m_transactionLayer(m_transactionLayer_),
+      baseAddress(0)
+    {
+        SC_THREAD(process_timeout);
+
+        // profiling
+        profile_write_count = 0;
+        profile_tlp_count = 0;
+        profile_byte_size = 0;
+        for (uint64_t& count : profile_flush_count) {
+            count = 0;
+        }
+
+        SC_LOG(INFO, "init done: enable=%d, timeout=%d ns", WriteCombineEnable, WriteCombineTimeout);
+    }
+
+    //  ====================================
+    //  public function can be used by other
+    //  ====================================
+    bool write(uint64_t address, std::vector<PCIeTLPPayload>* payloads);
+    bool fence();
+    void report_stats();
+    void save(CheckpointWriter& writer);
+    bool restore(CheckpointReader& reader);
+
+private:
+
+    // -- component
+    PCIeTransactionLayer *m_transactionLayer;
+    uint64_t baseAddress;
+    std::vector<PCIeTLPPayload> buffer;
+    sc_core::sc_time openTime;
+    sc_core::sc_event event_open;
+
+    // -- function
+    bool flush(WriteCombineFlush reason);
+    void process_timeout();
+
+    // -- profile
+    uint64_t profile_write_count;
+    uint64_t profile_tlp_count;
+    double profile_byte_size;
+    uint64_t profile_flush_count[static_cast<int>(WriteCombineFlush::Count)];
+
+};
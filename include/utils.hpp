@@ -2,6 +2,7 @@
 #include <systemc>
 #include <string>
 #include <random>
+#include <sstream>
 
 class Randomizer {
 public:
@@ -16,6 +17,18 @@ public:
         return temp_distrib(gen);
     }
 
+    // engine state in text form, for checkpoint
+    std::string get_state() const {
+        std::ostringstream os;
+        os << gen;
+        return os.str();
+    }
+
+    void set_state(const std::string& state) {
+        std::istringstream is(state);
+        is >> gen;
+    }
+
 private:
     std::uniform_int_distribution<> distrib;
     std::mt19937 gen;
@@ -5,9 +5,219 @@
 // #include "pcie_bus.hpp"
 #include "pcie_requester.hpp"
 #include "pcie_completer.hpp"
+#include "pcie_checkpoint.hpp"
+#include "pcie_sampling.hpp"
+#include "pcie_watchdog.hpp"
+#include "pcie_scoreboard.hpp"
+#include "pcie_partition.hpp"
+#include "pcie_sizing.hpp"
+#include "pcie_live_stats.hpp"
+#include "pcie_model.hpp"
+#include <chrono>
+#include <cstring>
+#include <cctype>
 
 #if 1
-int sc_main(int /*argc*/, char* /*argv*/[]) {
+// independent requester / completer links spread over forked processes, each synchronized only at its links
+static int run_partitioned(uint32_t links, uint32_t partitions, double run_time)
+{
+    if (RequesterTrafficMode != RequesterTrafficRandom) {
+        std::cout << "parallel mode needs RequesterTrafficMode = RequesterTrafficRandom" << std::endl;
+        return 1;
+    }
+    PCIePartitionTopology topology = {links, partitions};
+    PCIePartitionShared *shared = create_partition_shared(topology);
+    if (shared == nullptr) {
+        std::cout << "map partition shared memory failed, links <= " << PartitionMaxLinks << ", partitions <= " << PartitionMaxCount << std::endl;
+        return 1;
+    }
+
+    // every link end placed here, bound directly to its partner or through a proxy to the partner's partition
+    int id = fork_partitions(shared);
+    PCIePartition partition(("Partition-" + std::to_string(id)).c_str(), id, sc_core::sc_time(run_time, sc_core::SC_NS));
+    std::vector<PCIeRequester_*> requesters(links, nullptr);
+    std::vector<PCIeCompleter_*> completers(links, nullptr);
+    for (uint32_t link = 0; link < links; link++) {
+        std::string suffix = std::to_string(link);
+        if (topology.partition_of(link, 0) == static_cast<uint32_t>(id)) {
+            requesters[link] = new PCIeRequester_(("Requester-" + suffix).c_str(), link << 3);   // device l, function 0
+        }
+        if (topology.partition_of(link, 1) == static_cast<uint32_t>(id)) {
+            completers[link] = new PCIeCompleter_(("Completer-" + suffix).c_str(), link << 3);
+        }
+
+        if (requesters[link] != nullptr && completers[link] != nullptr) {
+            requesters[link]->m_dataLinkLayer->s_out.bind(completers[link]->m_dataLinkLayer->s_in);
+            requesters[link]->m_dataLinkLayer->s_in.bind(completers[link]->m_dataLinkLayer->s_out);
+            continue;
+        }
+        for (uint32_t side = 0; side < 2; side++) {
+            PCIeDataLinkLayer *dll = (side == 0) ? (requesters[link] ? requesters[link]->m_dataLinkLayer : nullptr)
+                                                 : (completers[link] ? completers[link]->m_dataLinkLayer : nullptr);
+            if (dll == nullptr) {
+                continue;
+            }
+            PCIeLinkProxy *proxy = new PCIeLinkProxy(("Link-" + suffix).c_str(), shared, id, link, side);
+            dll->s_out.bind(proxy->s_in);
+            proxy->s_out.bind(dll->s_in);
+            partition.add_proxy(proxy);
+        }
+    }
+
+    auto wall_start = std::chrono::steady_clock::now();
+    sc_core::sc_start();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+    // per partition results, the first partition reports last once every child has exited
+    if (id == 0) {
+        join_partitions(shared);
+    }
+    for (uint32_t link = 0; link < links; link++) {
+        if (requesters[link] != nullptr) {
+            std::cout << "partition " << id << " link " << link << " requester: sent " << requesters[link]->m_transactionLayer->get_throughput() << " GB/s, received " << requesters[link]->m_transactionLayer->get_rx_throughput() << " GB/s" << std::endl;
+        }
+        if (completers[link] != nullptr) {
+            std::cout << "partition " << id << " link " << link << " completer: received " << completers[link]->m_transactionLayer->get_rx_throughput() << " GB/s" << std::endl;
+        }
+    }
+    partition.report_stats();
+    PCIeInstrumentPolicy::report();
+    std::cout << "partition " << id << ": " << run_time << " ns simulated in " << wall << " s wall" << std::endl;
+    return 0;
+}
+
+// one sizing point: fresh model for SizingRunTime, payload delivered across the link and requester p99 latency
+static PCIeSizingResult run_sizing_point()
+{
+    PCIeRequester_ requester("Requester-0", 0);
+    PCIeCompleter_ completer("Completer-0", 0);
+    requester.m_dataLinkLayer->s_out.bind(completer.m_dataLinkLayer->s_in);
+    requester.m_dataLinkLayer->s_in.bind(completer.m_dataLinkLayer->s_out);
+#if RequesterTrafficMode == RequesterTrafficDMA
+    DMAHostDriver driver("HostDriver-0", completer.m_hostMemory, requester.m_dmaEngine, 0x10000000);
+    driver.set_iommu(completer.m_iommu);
+#endif
+
+    sc_core::sc_start(SizingRunTime, sc_core::SC_NS);
+    PCIeSizingResult result;
+    // payload that reached the far end, posted writes at the completer and read data at the requester
+    result.throughput = completer.m_transactionLayer->get_rx_throughput() + requester.m_transactionLayer->get_rx_throughput();
+    result.p99_latency = requester.m_transactionLayer->get_latency_percentile(0.99) * 1e9;
+    result.mean_latency = requester.m_transactionLayer->get_latency_mean() * 1e9;
+    return result;
+}
+
+static int run_sizing(double target_throughput, double target_latency)
+{
+    std::string workload = std::string((RequesterTrafficMode == RequesterTrafficDMA) ? "dma" : "random") + "-vc" + std::to_string(TLVCCount);
+    PCIeSizingSearch search(run_sizing_point, workload, target_throughput, target_latency);
+    search.run();
+    search.report_frontier();
+    return 0;
+}
+
+// the analytical model leaves out DMA traffic and IOMMU translation before memory accepts a write
+static bool model_covers()
+{
+    if (RequesterTrafficMode != RequesterTrafficRandom) {
+        std::cout << "analytical model covers RequesterTrafficMode = RequesterTrafficRandom only" << std::endl;
+        return false;
+    }
+    if (IOMMUEnable) {
+        std::cout << "analytical model covers IOMMUEnable = 0 only" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// analytical prediction for the current sizes, with check also simulated for SizingRunTime ns
+static int run_model(bool check)
+{
+    if (!model_covers()) {
+        return 1;
+    }
+    PCIeAnalyticModel model(PCIeModelWorkload{});
+    auto start = std::chrono::steady_clock::now();
+    PCIeModelResult predicted = model.predict(pcie_resource_config());
+    double elapse = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    model.report(predicted);
+    std::cout << "predicted in " << elapse << " us" << std::endl;
+    if (check) {
+        model.report_divergence(predicted, run_sizing_point());
+    }
+    return 0;
+}
+
+// every size combination up to ModelScreenScale x the defaults through the model,
+// the smallest ones predicted to reach the target are simulated to confirm
+static int run_model_screen(double target_throughput, double target_latency)
+{
+    if (!model_covers()) {
+        return 1;
+    }
+    PCIeAnalyticModel model(PCIeModelWorkload{});
+    PCIeResourceConfig defaults;
+    std::vector<std::pair<PCIeResourceConfig, PCIeModelResult>> candidates;
+    uint32_t screened = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t internal = PCIeMaxPayloadSize / 4; internal <= defaults.internalBufferSize * ModelScreenScale; internal *= 2) {
+        for (uint32_t replay = PCIeMaxPayloadSize / 4; replay <= defaults.replayBufferSize * ModelScreenScale; replay *= 2) {
+            for (uint32_t tag = 1; tag <= defaults.tagCount * ModelScreenScale; tag *= 2) {
+                for (uint32_t credit = PCIeCreditTypeCount * (PCIeMaxPayloadSize / 4); credit <= defaults.credits * ModelScreenScale; credit *= 2) {
+                    PCIeResourceConfig config = {internal, replay, tag, credit};
+                    PCIeModelResult predicted = model.predict(config);
+                    screened++;
+                    if (predicted.throughput >= target_throughput && predicted.p99_latency <= target_latency) {
+                        candidates.push_back(std::make_pair(config, predicted));
+                    }
+                }
+            }
+        }
+    }
+    double elapse = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "screened " << screened << " configurations in " << elapse << " ms, " << candidates.size() << " predicted to reach the target" << std::endl;
+
+    std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) { return pcie_resource_area(a.first) < pcie_resource_area(b.first); });
+    for (size_t i = 0; i < candidates.size() && i < ModelScreenSimulate; i++) {
+        const PCIeResourceConfig& config = candidates[i].first;
+        std::cout << "internal buffer=" << config.internalBufferSize << ", replay buffer=" << config.replayBufferSize << ", tag=" << config.tagCount
+                  << ", credit=" << config.credits << ", area=" << pcie_resource_area(config) << " B, binding: " << pcie_model_resource_name(candidates[i].second.binding) << std::endl;
+        model.report_divergence(candidates[i].second, pcie_simulate_forked(run_sizing_point, config));
+    }
+    return 0;
+}
+
+// ./_sim [--save <file> <ns>] [--restore <file>] [--parallel [links] [partitions] [ns]] [--size <GB/s> <p99 ns>]
+//        [--model] [--model-check] [--model-screen <GB/s> <p99 ns>]
+int sc_main(int argc, char* argv[]) {
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--parallel") == 0) {
+            // optional positional counts and run length, each only after the one before it
+            uint32_t links = 1;
+            uint32_t partitions = 2;
+            double run_time = PartitionRunTime;
+            if ((i + 1) < argc && std::isdigit(argv[i + 1][0])) {
+                links = std::atoi(argv[i + 1]);
+                if ((i + 2) < argc && std::isdigit(argv[i + 2][0])) {
+                    partitions = std::atoi(argv[i + 2]);
+                    if ((i + 3) < argc && std::isdigit(argv[i + 3][0])) {
+                        run_time = std::atof(argv[i + 3]);
+                    }
+                }
+            }
+            return run_partitioned(links, partitions, run_time);
+        }
+        if (std::strcmp(argv[i], "--size") == 0 && (i + 2) < argc) {
+            return run_sizing(std::atof(argv[i + 1]), std::atof(argv[i + 2]));
+        }
+        if (std::strcmp(argv[i], "--model") == 0 || std::strcmp(argv[i], "--model-check") == 0) {
+            return run_model(std::strcmp(argv[i], "--model-check") == 0);
+        }
+        if (std::strcmp(argv[i], "--model-screen") == 0 && (i + 2) < argc) {
+            return run_model_screen(std::atof(argv[i + 1]), std::atof(argv[i + 2]));
+        }
+    }
 
     PCIeRequester_ requester("Requester-0", 0);
     PCIeCompleter_ completer("Completer-0", 0);
@@ -15,9 +225,43 @@ int sc_main(int /*argc*/, char* /*argv*/[]) {
     requester.m_dataLinkLayer->s_out.bind(completer.m_dataLinkLayer->s_in);
     requester.m_dataLinkLayer->s_in.bind(completer.m_dataLinkLayer->s_out);
 
+    PCIeScoreboard scoreboard("Scoreboard");
+    scoreboard.connect(requester.m_dataLinkLayer, completer.m_dataLinkLayer);
+
+#if RequesterTrafficMode == RequesterTrafficDMA
+    DMAHostDriver driver("HostDriver-0", completer.m_hostMemory, requester.m_dmaEngine, 0x10000000);
+    driver.set_iommu(completer.m_iommu);
+#if TLVCCount > 1
+    // second ring on the highest TC, its VC weighted 2:1 at the requester
+    DMAHostDriver driver_high("HostDriver-1", completer.m_hostMemory, requester.m_dmaEngine, 0x20000000, PCIeMaxVCCount - 1);
+    driver_high.set_iommu(completer.m_iommu);
+    requester.m_transactionLayer->set_vc_arbitration(PCIeVCArbitration::WeightedRoundRobin);
+    requester.m_transactionLayer->set_vc_weight(TLVCCount - 1, 2);
+#endif
+#endif
+
+    PCIeSamplingController sampling("Sampling", &requester, &completer);
+    PCIeCheckpointController checkpoint("Checkpoint", &requester, &completer);
+    PCIeWatchdog watchdog("Watchdog", &requester, &completer, &checkpoint);
+    PCIeLiveStats livestats("LiveStats", &requester);
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--save") == 0 && (i + 2) < argc) {
+            checkpoint.schedule_save(argv[i + 1], sc_core::sc_time(std::atof(argv[i + 2]), sc_core::SC_NS));
+            i += 2;
+        }
+        else if (std::strcmp(argv[i], "--restore") == 0 && (i + 1) < argc) {
+            if (!checkpoint.restore(argv[i + 1])) {
+                return 1;
+            }
+            i += 1;
+        }
+    }
+
     std::cout << "Starting simulation..." << std::endl;
     sc_core::sc_start();
     std::cout << "Simulation finished at " << sc_core::sc_time_stamp() << std::endl;
+    scoreboard.report_stats();
+    PCIeInstrumentPolicy::report();
 
     return 0;
 }
@@ -0,0 +1,204 @@
+#include "memory_backend.hpp"
+
+//  =================================
+//  MemoryBackend Function Definition
+//  =================================
+
+MemoryAccess MemoryBackend::access(uint64_t address, uint32_t length, bool write, sc_core::sc_time start)
+{
+    MemoryAccess result;
+    if (functional) {
+        result.accept_time = start;
+        result.done_time = start + sc_core::sc_time(MemoryFixedLatency, SC_NS);
+        return result;
+    }
+
+    // start times can arrive out of order, so only requests retired by now are dropped
+    // and the queue occupancy is counted at the request's own start time
+    while (!outstanding.empty() && *outstanding.begin() <= sc_core::sc_time_stamp()) {
+        outstanding.erase(outstanding.begin());
+    }
+    result.accept_time = start;
+    auto busy = outstanding.upper_bound(start);
+    uint32_t busy_count = std::distance(busy, outstanding.end());
+    if (busy_count >= MemoryQueueDepth) {
+        // controller queue is full, request waits until enough of them retire
+        std::advance(busy, busy_count - MemoryQueueDepth);
+        result.accept_time = *busy;
+        profile_stall += (result.accept_time - start).to_seconds();
+    }
+
+    result.done_time = service(address, length, write, result.accept_time);
+    outstanding.insert(result.done_time);
+
+    // profiling
+    if (write) {
+        profile_write_count++;
+    }
+    else {
+        profile_read_count++;
+    }
+    profile_byte_size += length;
+    profile_latency += (result.done_time - start).to_seconds();
+    SC_LOG(VERB, "access: address=0x%llx, length=%u, write=%d, latency=%.2f ns", static_cast<unsigned long long>(address), length, write, (result.done_time - start).to_seconds() * 1e9);
+
+    return result;
+}
+
+bool MemoryBackend::get_direct_mem_ptr(uint64_t address, tlm::tlm_dmi& dmi_data)
+{
+    // one DMI region per host memory page, functional access skips timing
+    uint64_t base = address & ~static_cast<uint64_t>(HostMemoryPageSize - 1);
+    dmi_data.set_dmi_ptr(reinterpret_cast<unsigned char*>(m_hostMemory->get_page(address)));
+    dmi_data.set_start_address(base);
+    dmi_data.set_end_address(base + HostMemoryPageSize - 1);
+    dmi_data.set_read_latency(SC_ZERO_TIME);
+    dmi_data.set_write_latency(SC_ZERO_TIME);
+    dmi_data.allow_read_write();
+    return true;
+}
+
+void MemoryBackend::save(CheckpointWriter& writer)
+{
+    writer.section(name());
+    writer.put<uint32_t>(outstanding.size());
+    for (const sc_core::sc_time& time : outstanding) {
+        writer.put_time(time);
+    }
+}
+
+bool MemoryBackend::restore(CheckpointReader& reader)
+{
+    if (!reader.section(name())) {
+        return false;
+    }
+    outstanding.clear();
+    for (uint32_t count = reader.get<uint32_t>(); count > 0; count--) {
+        outstanding.insert(reader.get_time());
+    }
+    return reader.good();
+}
+
+void MemoryBackend::report_stats()
+{
+    uint64_t count = profile_read_count + profile_write_count;
+    if (count == 0) {
+        return;
+    }
+    SC_LOG(INFO, "memory read: %llu, write: %llu, avg latency: %.2f ns, avg queue stall: %.2f ns", static_cast<unsigned long long>(profile_read_count), static_cast<unsigned long long>(profile_write_count), (profile_latency / count) * 1e9, (profile_stall / count) * 1e9);
+}
+
+//  ======================================
+//  FixedLatencyMemory Function Definition
+//  ======================================
+
+sc_core::sc_time FixedLatencyMemory::service(uint64_t address, uint32_t length, bool write, sc_core::sc_time start)
+{
+    (void)address;
+    (void)write;
+    sc_core::sc_time begin = std::max(start, busFree);
+    sc_core::sc_time transfer = sc_core::sc_time(static_cast<double>(length) / MemoryFixedBandwidth, SC_NS);
+    busFree = begin + transfer;
+    return begin + transfer + sc_core::sc_time(MemoryFixedLatency, SC_NS);
+}
+
+void FixedLatencyMemory::save(CheckpointWriter& writer)
+{
+    MemoryBackend::save(writer);
+    writer.put_time(busFree);
+}
+
+bool FixedLatencyMemory::restore(CheckpointReader& reader)
+{
+    if (!MemoryBackend::restore(reader)) {
+        return false;
+    }
+    busFree = reader.get_time();
+    return reader.good();
+}
+
+//  ==============================
+//  DRAMMemory Function Definition
+//  ==============================
+
+sc_core::sc_time DRAMMemory::service(uint64_t address, uint32_t length, bool write, sc_core::sc_time start)
+{
+    (void)write;
+    sc_core::sc_time done = start;
+    sc_core::sc_time tRCD = sc_core::sc_time(DRAMtRCD, SC_NS);
+    sc_core::sc_time tCL = sc_core::sc_time(DRAMtCL, SC_NS);
+    sc_core::sc_time tRP = sc_core::sc_time(DRAMtRP, SC_NS);
+    sc_core::sc_time tBurst = sc_core::sc_time(DRAMtBurst, SC_NS);
+
+    uint64_t first = address / DRAMBurstSize;
+    uint64_t last = (address + std::max<uint32_t>(length, 1) - 1) / DRAMBurstSize;
+    for (uint64_t burst = first; burst <= last; burst++) {
+        uint32_t channel = burst % DRAMChannels;
+        uint64_t column = (burst / DRAMChannels) * DRAMBurstSize;
+        uint32_t bank_index = (column / DRAMRowSize) % DRAMBanks;
+        uint64_t row = column / (static_cast<uint64_t>(DRAMRowSize) * DRAMBanks);
+        Bank& bank = banks[(channel * DRAMBanks) + bank_index];
+
+        // open-page policy, row stays open until another row is needed
+        sc_core::sc_time issue = std::max(start, bank.ready);
+        if (bank.open && bank.row == row) {
+            profile_row_hit++;
+        }
+        else if (bank.open) {
+            issue += tRP + tRCD;
+            profile_row_conflict++;
+        }
+        else {
+            issue += tRCD;
+            profile_row_miss++;
+        }
+        bank.open = true;
+        bank.row = row;
+        bank.ready = issue + tBurst;
+
+        sc_core::sc_time data = std::max(issue + tCL, busFree[channel]);
+        busFree[channel] = data + tBurst;
+        done = std::max(done, data + tBurst);
+    }
+
+    return done;
+}
+
+void DRAMMemory::report_stats()
+{
+    MemoryBackend::report_stats();
+    uint64_t count = profile_row_hit + profile_row_miss + profile_row_conflict;
+    if (count == 0) {
+        return;
+    }
+    SC_LOG(INFO, "row buffer hit: %.2f%%, miss: %.2f%%, conflict: %.2f%%", (100.0 * profile_row_hit) / count, (100.0 * profile_row_miss) / count, (100.0 * profile_row_conflict) / count);
+}
+
+void DRAMMemory::save(CheckpointWriter& writer)
+{
+    MemoryBackend::save(writer);
+    for (const Bank& bank : banks) {
+        writer.put(bank.open);
+        writer.put(bank.row);
+        writer.put_time(bank.ready);
+    }
+    for (const sc_core::sc_time& time : busFree) {
+        writer.put_time(time);
+    }
+}
+
+bool DRAMMemory::restore(CheckpointReader& reader)
+{
+    if (!MemoryBackend::restore(reader)) {
+        return false;
+    }
+    for (Bank& bank : banks) {
+        bank.open = reader.get<bool>();
+        bank.row = reader.get<uint64_t>();
+        bank.ready = reader.get_time();
+    }
+    for (sc_core::sc_time& time : busFree) {
+        time = reader.get_time();
+    }
+    return reader.good();
+}
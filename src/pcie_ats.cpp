@@ -0,0 +1,177 @@
+#include "pcie_ats.hpp"
+
+//  =============================
+//  PCIeIOMMU Function Definition
+//  =============================
+
+sc_core::sc_time PCIeIOMMU::translate(uint64_t address, uint8_t at, uint64_t& translated)
+{
+    translated = address;
+    if (!IOMMUEnable || at == PCIeATTranslated) {
+        return SC_ZERO_TIME;
+    }
+
+    uint64_t page = address / ATSPageSize;
+    uint64_t translated_page;
+    sc_core::sc_time latency = sc_core::sc_time(IOMMUIOTLBLatency, SC_NS);
+    profile_lookup_count++;
+    if (iotlb.lookup(page, translated_page)) {
+        profile_hit_count++;
+    }
+    else {
+        latency += sc_core::sc_time(IOMMUPageWalkLevels * IOMMUPageWalkLatency, SC_NS);
+        iotlb.insert(page, page);
+        profile_walk_count++;
+        SC_LOG(VERB, "page walk: address=0x%llx", address);
+    }
+
+    profile_latency += latency.to_seconds();
+    return latency;
+}
+
+void PCIeIOMMU::unmap(uint64_t address, uint32_t length)
+{
+    uint64_t first = address / ATSPageSize;
+    uint64_t last = (address + length - 1) / ATSPageSize;
+    for (uint64_t page = first; page <= last; page++) {
+        iotlb.invalidate(page);
+        if (ATSEnable && invalidate_handler) {
+            invalidate_handler(page * ATSPageSize, invalidateTag++);
+            profile_invalidate_count++;
+            profile_invalidate_pending++;
+        }
+    }
+}
+
+void PCIeIOMMU::complete_invalidation(uint32_t itag)
+{
+    profile_invalidate_pending--;
+    SC_LOG(VERB, "invalidation done, itag=%d", itag);
+}
+
+void PCIeIOMMU::register_invalidate(std::function<void(uint64_t, uint32_t)> handler)
+{
+    invalidate_handler = handler;
+}
+
+void PCIeIOMMU::save(CheckpointWriter& writer)
+{
+    writer.section(name());
+    iotlb.save(writer);
+    writer.put(invalidateTag);
+}
+
+bool PCIeIOMMU::restore(CheckpointReader& reader)
+{
+    if (!reader.section(name())) {
+        return false;
+    }
+    iotlb.restore(reader);
+    invalidateTag = reader.get<uint32_t>();
+    return reader.good();
+}
+
+void PCIeIOMMU::report_stats()
+{
+    if (profile_lookup_count == 0) {
+        return;
+    }
+    SC_LOG(INFO, "IOTLB hit rate: %.2f%%, page walk: %llu, avg added latency: %.2f ns, invalidation: %llu (pending %llu)", (100.0 * profile_hit_count) / profile_lookup_count, static_cast<unsigned long long>(profile_walk_count), (profile_latency / profile_lookup_count) * 1e9, static_cast<unsigned long long>(profile_invalidate_count), static_cast<unsigned long long>(profile_invalidate_pending));
+}
+
+//  ===========================
+//  PCIeATC Function Definition
+//  ===========================
+
+ATCLookup PCIeATC::lookup(uint64_t address, uint64_t& translated, bool retry)
+{
+    uint64_t page = address / ATSPageSize;
+    uint64_t translated_page;
+    if (!retry) {
+        profile_lookup_count++;
+    }
+    if (atc.lookup(page, translated_page)) {
+        profile_hit_count += retry ? 0 : 1;
+        translated = (translated_page * ATSPageSize) + (address % ATSPageSize);
+        return ATCLookup::Hit;
+    }
+
+    // miss, one Translation Request per page, the caller retries once the translation handler ran;
+    // a refused request leaves no page pending, so the caller must not wait for the handler
+    auto it = pendingPage.find(page);
+    bool sent = false;
+    if (it == pendingPage.end()) {
+        if (m_transactionLayer->send_read_TLP(page * ATSPageSize, 2, 0, 0, PCIeATTranslationReq) != true) {
+            return ATCLookup::Retry;
+        }
+        it = pendingPage.emplace(page, ATC_pending{sc_core::sc_time_stamp(), 0}).first;
+        sent = true;
+        profile_request_count++;
+        SC_LOG(VERB, "send Translation Request: address=0x%llx", page * ATSPageSize);
+    }
+    if (!retry || sent) {
+        it->second.waiters++;
+    }
+    return ATCLookup::Miss;
+}
+
+void PCIeATC::register_translation(std::function<void()> handler)
+{
+    translation_handler = handler;
+}
+
+void PCIeATC::receive_translation(const PCIeTLPHeader& header, std::vector<PCIeTLPPayload>* payloads)
+{
+    // DW0: translated[31:12] | W | R, DW1: translated[63:32]
+    uint64_t page = get_tlp_address(header) / ATSPageSize;
+    uint64_t translated = (static_cast<uint64_t>(payloads->at(1).payload) << 32) | (payloads->at(0).payload & ~static_cast<uint32_t>(ATSPageSize - 1));
+
+    atc.insert(page, translated / ATSPageSize);
+    auto it = pendingPage.find(page);
+    if (it != pendingPage.end()) {
+        profile_latency += (sc_core::sc_time_stamp() - it->second.start).to_seconds() * it->second.waiters;
+        pendingPage.erase(it);
+    }
+    if (translation_handler) {
+        translation_handler();
+    }
+    SC_LOG(VERB, "get Translation Completion: address=0x%llx, translated=0x%llx", page * ATSPageSize, translated);
+}
+
+void PCIeATC::receive_invalidation(std::vector<PCIeTLPPayload>* payloads)
+{
+    // DW0: code, DW1: address[31:0], DW2: address[63:32], DW3: itag
+    uint64_t address = (static_cast<uint64_t>(payloads->at(2).payload) << 32) | payloads->at(1).payload;
+    atc.invalidate(address / ATSPageSize);
+    profile_invalidate_count++;
+
+    invalidation_queue.push(payloads->at(3).payload);
+    event_invalidation.notify();
+    SC_LOG(VERB, "get Invalidate Request: address=0x%llx", address);
+}
+
+void PCIeATC::process_invalidation()
+{
+    while (true) {
+        wait(event_invalidation);
+
+        while (!invalidation_queue.empty()) {
+            std::vector<PCIeTLPPayload> payloads(2);
+            payloads[0].payload = static_cast<uint32_t>(PCIeMsgCode::ATSInvalidateCompletion);
+            payloads[1].payload = invalidation_queue.front();
+            invalidation_queue.pop();
+
+            while (m_transactionLayer->send_TLP(PCIeTLPType::MsgD, &payloads) != true) {
+                wait(5, sc_core::SC_NS);
+            }
+        }
+    }
+}
+
+void PCIeATC::report_stats()
+{
+    if (profile_lookup_count == 0) {
+        return;
+    }
+    SC_LOG(INFO, "ATC hit rate: %.2f%%, translation request: %llu, invalidation: %llu, avg added latency: %.2f ns", (100.0 * profile_hit_count) / profile_lookup_count, static_cast<unsigned long long>(profile_request_count), static_cast<unsigned long long>(profile_invalidate_count), (profile_latency / profile_lookup_count) * 1e9);
+}
@@ -0,0 +1,102 @@
+#include "pcie_checkpoint.hpp"
+
+//  ============================================
+//  PCIeCheckpointController Function Definition
+//  ============================================
+
+void PCIeCheckpointController::schedule_save(const std::string& path, sc_core::sc_time time)
+{
+    savePath = path;
+    saveTime = time;
+}
+
+void PCIeCheckpointController::process_save()
+{
+    if (savePath.empty()) {
+        return;
+    }
+    if (RequesterTrafficMode != RequesterTrafficRandom) {
+        SC_LOG(ERROR, "checkpoint needs RequesterTrafficMode = RequesterTrafficRandom");
+        return;
+    }
+
+    wait(saveTime);
+
+    // drain the link, TLPs keep queuing in the replay buffer meanwhile
+    m_requester->m_dataLinkLayer->pause_transmit();
+    m_completer->m_dataLinkLayer->pause_transmit();
+    sc_core::sc_time drain_start = sc_core::sc_time_stamp();
+    while (!m_requester->m_dataLinkLayer->link_is_idle() || !m_completer->m_dataLinkLayer->link_is_idle()) {
+        wait(CheckpointDrainPoll, SC_NS);
+    }
+    SC_LOG(INFO, "link drained in %.2f ns", (sc_core::sc_time_stamp() - drain_start).to_seconds() * 1e9);
+
+    save(savePath);
+
+    m_requester->m_dataLinkLayer->resume_transmit();
+    m_completer->m_dataLinkLayer->resume_transmit();
+}
+
+bool PCIeCheckpointController::save(const std::string& path)
+{
+    CheckpointWriter writer(path);
+    save_config(writer);
+    m_requester->save(writer);
+    m_completer->save(writer);
+    if (!writer.good()) {
+        SC_LOG(ERROR, "write checkpoint failed: %s", path.c_str());
+        return false;
+    }
+    SC_LOG(INFO, "save checkpoint: %s", path.c_str());
+    return true;
+}
+
+bool PCIeCheckpointController::restore(const std::string& path)
+{
+    if (RequesterTrafficMode != RequesterTrafficRandom) {
+        SC_LOG(ERROR, "checkpoint needs RequesterTrafficMode = RequesterTrafficRandom");
+        return false;
+    }
+
+    CheckpointReader reader(path);
+    if (!reader.good() || !restore_config(reader) || !m_requester->restore(reader) || !m_completer->restore(reader)) {
+        SC_LOG(ERROR, "restore checkpoint failed: %s", path.c_str());
+        return false;
+    }
+    SC_LOG(INFO, "restore checkpoint: %s, taken at %.2f ns", path.c_str(), reader.get_saved_time() * 1e9);
+    return true;
+}
+
+void PCIeCheckpointController::save_config(CheckpointWriter& writer)
+{
+    const PCIeResourceConfig& config = pcie_resource_config();
+    writer.section("config");
+    writer.put<uint32_t>(config.internalBufferSize);
+    writer.put<uint32_t>(config.replayBufferSize);
+    writer.put<uint32_t>(config.tagCount);
+    writer.put<uint32_t>(config.credits);
+    writer.put<uint32_t>(TLVCCount);
+}
+
+bool PCIeCheckpointController::restore_config(CheckpointReader& reader)
+{
+    // state is laid out by these sizes, restoring into another configuration would corrupt it
+    const PCIeResourceConfig& config = pcie_resource_config();
+    if (!reader.section("config")) {
+        return false;
+    }
+    uint32_t internalBufferSize = reader.get<uint32_t>();
+    uint32_t replayBufferSize = reader.get<uint32_t>();
+    uint32_t tagCount = reader.get<uint32_t>();
+    uint32_t credits = reader.get<uint32_t>();
+    uint32_t vcCount = reader.get<uint32_t>();
+    if (!reader.good()) {
+        return false;
+    }
+    if (internalBufferSize != config.internalBufferSize || replayBufferSize != config.replayBufferSize || tagCount != config.tagCount || credits != config.credits || vcCount != TLVCCount) {
+        SC_LOG(ERROR, "checkpoint config: internal buffer=%d, replay buffer=%d, tag=%d, credit=%d, vc=%d", internalBufferSize, replayBufferSize, tagCount, credits, vcCount);
+        SC_LOG(ERROR, "model config: internal buffer=%d, replay buffer=%d, tag=%d, credit=%d, vc=%d", config.internalBufferSize, config.replayBufferSize, config.tagCount, config.credits, TLVCCount);
+        return false;
+    }
+    return true;
+}
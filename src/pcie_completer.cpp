@@ -23,4 +23,289 @@
 
 //         wait(50, sc_core::SC_NS);
 //     }
-// }
\ No newline at end of file
+// }
+
+sc_core::sc_time PCIeCompleter_::receive_TLP(const PCIeTLPHeader& header, std::vector<PCIeTLPPayload>* payloads)
+{
+    PCIeTLPType type = static_cast<PCIeTLPType>(header.Type);
+    uint64_t address = get_tlp_address(header);
+    uint64_t translated = address;
+    sc_core::sc_time latency = SC_ZERO_TIME;
+    sc_core::sc_time hold_time = SC_ZERO_TIME;
+    if (type == PCIeTLPType::MWr || type == PCIeTLPType::MRd) {
+        latency = m_iommu->translate(address, header.AT, translated);
+    }
+
+    if (type == PCIeTLPType::MWr) {
+        if (address >= HostMSIAddressBase && address < (HostMSIAddressBase + HostMSIAddressSize)) {
+            profile_msix_count++;
+            SC_LOG(DEBUG, "get MSI-X, data=0x%x, count=%d", payloads->at(0).payload, profile_msix_count);
+            return SC_ZERO_TIME;
+        }
+
+        // fast-forward stores straight through DMI once no timed write is still pending
+        if (m_memory->is_functional() && write_queue.empty() && write_direct(translated, payloads)) {
+            return SC_ZERO_TIME;
+        }
+
+        // the receive buffer entry is held until memory accepts the write, after translation
+        MemoryAccess access = m_memory->access(translated, payloads->size() * 4, true, sc_core::sc_time_stamp() + latency);
+        hold_time = access.accept_time - sc_core::sc_time_stamp();
+
+        // data lands once memory absorbed it, only a Relaxed Ordering write may overtake an earlier one
+        sc_core::sc_time visible = access.done_time;
+        if (!may_pass_writes(header)) {
+            visible = std::max(visible, lastWriteVisible);
+        }
+        lastWriteVisible = std::max(lastWriteVisible, visible);
+        Completer_write write;
+        write.address = translated;
+        for (size_t i = 0; i < payloads->size(); i++) {
+            write.data.push_back(payloads->at(i).payload);
+        }
+        write_queue.emplace(visible, write);
+        event_write_queue.notify();
+        SC_LOG(VERB, "MWr: address=0x%llx, length=%d, visible in %.2f ns", address, payloads->size(), (visible - sc_core::sc_time_stamp()).to_seconds() * 1e9);
+    }
+
+    else if (type == PCIeTLPType::MRd) {
+        Completer_request request;
+        request.header = header;
+        request.address = address;
+        request.ready_time = sc_core::sc_time_stamp() + latency;
+        if (header.AT != PCIeATTranslationReq) {
+            // a read never passes the posted writes before it, relaxed or not
+            uint32_t length = (header.Length == 0) ? 1024 : header.Length;
+            MemoryAccess access = m_memory->access(translated, length * 4, false, request.ready_time);
+            request.ready_time = access.done_time;
+            if (!may_pass_writes(header)) {
+                request.ready_time = std::max(request.ready_time, lastWriteVisible);
+            }
+            hold_time = access.accept_time - sc_core::sc_time_stamp();
+        }
+        request_queue.push(request);
+        event_request_queue.notify();
+        SC_LOG(VERB, "MRd: address=0x%llx, length=%d", address, header.Length);
+    }
+
+    else if (type == PCIeTLPType::MsgD && payloads->at(0).payload == static_cast<uint32_t>(PCIeMsgCode::ATSInvalidateCompletion)) {
+        m_iommu->complete_invalidation(payloads->at(1).payload);
+    }
+
+    else {
+        SC_LOG(WARN, "unhandled TLP type=%d", header.Type);
+    }
+
+    if (type == PCIeTLPType::MWr || type == PCIeTLPType::MRd) {
+        profile_access_count++;
+        if ((profile_access_count % 10000) == 0) {
+            m_memory->report_stats();
+            m_dataLinkLayer->report_rx_stats();
+            m_transactionLayer->report_pipeline_stats();
+            m_dataLinkLayer->report_pipeline_stats();
+            m_dataLinkLayer->report_aspm_stats();
+        }
+    }
+
+    return hold_time;
+}
+
+void PCIeCompleter_::process_completion()
+{
+    while (true) {
+        wait(event_request_queue);
+
+        while (!request_queue.empty()) {
+            Completer_request request = request_queue.front();
+            request_queue.pop();
+
+            if (request.ready_time > sc_core::sc_time_stamp()) {
+                wait(request.ready_time - sc_core::sc_time_stamp());
+            }
+
+            // Translation Completion, DW0: translated[31:12] | W | R, DW1: translated[63:32]
+            if (request.header.AT == PCIeATTranslationReq) {
+                std::vector<PCIeTLPPayload> payloads(2);
+                payloads[0].payload = (static_cast<uint32_t>(request.address) & ~static_cast<uint32_t>(ATSPageSize - 1)) | 0x3;
+                payloads[1].payload = static_cast<uint32_t>(request.address >> 32);
+                while (m_transactionLayer->send_completion(request.header, request.address, &payloads) != true) {
+                    wait(5, sc_core::SC_NS);
+                }
+                SC_LOG(VERB, "send Translation Completion: address=0x%llx", request.address);
+                continue;
+            }
+
+            // split read data into completions no larger than MPS
+            uint32_t remain = (request.header.Length == 0) ? 1024 : request.header.Length;
+            uint64_t address = request.address;
+            while (remain > 0) {
+                uint32_t length = std::min<uint32_t>(remain, PCIeMaxPayloadSize / 4);
+
+                std::vector<PCIeTLPPayload> payloads(length);
+                for (uint32_t dw = 0; dw < length; dw++) {
+                    payloads[dw].payload = m_hostMemory->read_dw(address + (dw * 4));   // IOVA is mapped 1:1
+                }
+
+                while (m_transactionLayer->send_completion(request.header, address, &payloads) != true) {
+                    wait(5, sc_core::SC_NS);
+                }
+                SC_LOG(VERB, "send CplD: address=0x%llx, length=%d, tag=%d", address, length, request.header.tag);
+
+                remain -= length;
+                address += (length * 4);
+            }
+        }
+    }
+}
+
+void PCIeCompleter_::process_invalidation()
+{
+    while (true) {
+        wait(event_invalidation_queue);
+
+        // Invalidate Request, DW0: message code, DW1: address[31:0], DW2: address[63:32], DW3: itag
+        while (!invalidation_queue.empty()) {
+            Completer_invalidation invalidation = invalidation_queue.front();
+            invalidation_queue.pop();
+
+            std::vector<PCIeTLPPayload> payloads(4);
+            payloads[0].payload = static_cast<uint32_t>(PCIeMsgCode::ATSInvalidateRequest);
+            payloads[1].payload = static_cast<uint32_t>(invalidation.address);
+            payloads[2].payload = static_cast<uint32_t>(invalidation.address >> 32);
+            payloads[3].payload = invalidation.itag;
+            while (m_transactionLayer->send_TLP(PCIeTLPType::MsgD, &payloads) != true) {
+                wait(5, sc_core::SC_NS);
+            }
+            SC_LOG(VERB, "send Invalidate Request: address=0x%llx, itag=%d", invalidation.address, invalidation.itag);
+        }
+    }
+}
+
+void PCIeCompleter_::process_write()
+{
+    while (true) {
+        if (write_queue.empty()) {
+            wait(event_write_queue);
+            continue;
+        }
+
+        auto it = write_queue.begin();
+        if (it->first > sc_core::sc_time_stamp()) {
+            wait(it->first - sc_core::sc_time_stamp(), event_write_queue);
+            continue;
+        }
+        for (size_t i = 0; i < it->second.data.size(); i++) {
+            m_hostMemory->write_dw(it->second.address + (i * 4), it->second.data[i]);
+        }
+        write_queue.erase(it);
+    }
+}
+
+bool PCIeCompleter_::may_pass_writes(const PCIeTLPHeader& header)
+{
+    // earlier writes are taken to be of the same stream, IDO never lets the TLP pass them here
+    uint16_t stream = get_tlp_stream_id(header);
+    PCIeOrderingKey row = {static_cast<PCIeTLPType>(header.Type), get_tlp_attr(header), stream, header.reqID, 0};
+    PCIeOrderingKey col = {PCIeTLPType::MWr, 0, stream, header.reqID, 0};
+    return ordering_may_pass(row, col, true);
+}
+
+bool PCIeCompleter_::write_direct(uint64_t address, std::vector<PCIeTLPPayload>* payloads)
+{
+    // every DMI region is checked before any data is stored, a refused one leaves the write to the timed path
+    std::vector<std::pair<uint32_t*, size_t>> spans;
+    size_t i = 0;
+    while (i < payloads->size()) {
+        uint64_t dw_address = address + (i * 4);
+        if (!dmiValid || dw_address < dmi.get_start_address() || dw_address > dmi.get_end_address()) {
+            dmiValid = m_memory->get_direct_mem_ptr(dw_address, dmi) && dmi.is_write_allowed() && dmi.get_dmi_ptr() != nullptr;
+            if (!dmiValid || dw_address < dmi.get_start_address() || dw_address > dmi.get_end_address()) {
+                dmiValid = false;
+                return false;
+            }
+        }
+
+        // the rest of the TLP that falls in this DMI region
+        uint32_t* ptr = reinterpret_cast<uint32_t*>(dmi.get_dmi_ptr() + (dw_address - dmi.get_start_address()));
+        size_t count = std::min<size_t>(payloads->size() - i, ((dmi.get_end_address() - dw_address) / 4) + 1);
+        spans.push_back({ptr, count});
+        i += count;
+    }
+
+    i = 0;
+    for (const auto& span : spans) {
+        for (size_t dw = 0; dw < span.second; dw++) {
+            span.first[dw] = payloads->at(i + dw).payload;
+        }
+        i += span.second;
+    }
+    return true;
+}
+
+bool PCIeCompleter_::get_direct_mem_ptr(uint64_t address, tlm::tlm_dmi& dmi_data)
+{
+    // granted only while writes skip timing and land untranslated, and never over the MSI-X window;
+    // the requester drops the region when the mode changes, so no invalidation is needed
+    uint64_t base = address & ~static_cast<uint64_t>(HostMemoryPageSize - 1);
+    bool msix = base < (HostMSIAddressBase + HostMSIAddressSize) && (base + HostMemoryPageSize) > HostMSIAddressBase;
+    if (IOMMUEnable || msix || !m_memory->is_functional() || !write_queue.empty()) {
+        return false;
+    }
+    return m_memory->get_direct_mem_ptr(address, dmi_data);
+}
+
+unsigned int PCIeCompleter_::transport_dbg(uint64_t address, unsigned char* data, unsigned int length, bool write)
+{
+    // untimed access to host memory, page by page
+    unsigned int done = 0;
+    while (done < length) {
+        uint64_t current = address + done;
+        uint32_t offset = current % HostMemoryPageSize;
+        unsigned int count = std::min<unsigned int>(length - done, HostMemoryPageSize - offset);
+        unsigned char* page = reinterpret_cast<unsigned char*>(m_hostMemory->get_page(current)) + offset;
+        if (write) {
+            std::memcpy(page, data + done, count);
+        }
+        else {
+            std::memcpy(data + done, page, count);
+        }
+        done += count;
+    }
+    return done;
+}
+
+void PCIeCompleter_::save(CheckpointWriter& writer)
+{
+    writer.section(name());
+    writer.put<uint32_t>(write_queue.size());
+    for (const auto& entry : write_queue) {
+        writer.put_time(entry.first);
+        writer.put(entry.second.address);
+        writer.put_vector(entry.second.data);
+    }
+    writer.put_time(lastWriteVisible);
+    m_transactionLayer->save(writer);
+    m_dataLinkLayer->save(writer);
+    m_hostMemory->save(writer);
+    m_memory->save(writer);
+    m_iommu->save(writer);
+}
+
+bool PCIeCompleter_::restore(CheckpointReader& reader)
+{
+    if (!reader.section(name())) {
+        return false;
+    }
+    write_queue.clear();
+    for (uint32_t count = reader.get<uint32_t>(); count > 0; count--) {
+        sc_core::sc_time visible = reader.get_time();
+        Completer_write write;
+        write.address = reader.get<uint64_t>();
+        reader.get_vector(write.data);
+        write_queue.emplace(visible, write);
+    }
+    lastWriteVisible = reader.get_time();
+    event_write_queue.notify(SC_ZERO_TIME);
+    dmiValid = false;
+    return m_transactionLayer->restore(reader) && m_dataLinkLayer->restore(reader) && m_hostMemory->restore(reader) && m_memory->restore(reader) && m_iommu->restore(reader);
+}
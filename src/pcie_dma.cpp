@@ -0,0 +1,397 @@
+#include "pcie_dma.hpp"
+
+//  =================================
+//  PCIeDMAEngine Function Definition
+//  =================================
+
+uint32_t PCIeDMAEngine::add_ring(uint64_t sq_base, uint64_t cq_base, uint32_t entries, uint64_t msix_address, uint32_t msix_data)
+{
+    DMARing ring;
+    ring.sq_base = sq_base;
+    ring.cq_base = cq_base;
+    ring.entries = entries;
+    ring.sq_head = 0;
+    ring.sq_tail = 0;
+    ring.cq_tail = 0;
+    ring.cq_phase = 1;
+    ring.fetching = false;
+    ring.msix_address = msix_address;
+    ring.msix_data = msix_data;
+    rings.push_back(ring);
+    SC_LOG(INFO, "add ring[%d]: sq_base=0x%llx, cq_base=0x%llx, entries=%d", rings.size() - 1, sq_base, cq_base, entries);
+    return rings.size() - 1;
+}
+
+void PCIeDMAEngine::ring_doorbell(uint32_t ring, uint32_t sq_tail)
+{
+    rings[ring].sq_tail = sq_tail;
+    event_doorbell.notify();
+    SC_LOG(VERB, "doorbell ring[%d]: sq_tail=%d", ring, sq_tail);
+}
+
+void PCIeDMAEngine::process_fetch_descriptor()
+{
+    while (true) {
+        wait(event_doorbell);
+
+        bool progress = true;
+        while (progress) {
+            progress = false;
+            for (uint32_t n = 0; n < rings.size(); n++) {
+                uint32_t r = (fetchRing + n) % rings.size();
+                DMARing& ring = rings[r];
+                if (ring.fetching || ring.sq_head == ring.sq_tail) {
+                    continue;
+                }
+
+                // keep at most DMAMaxInflightDesc descriptors fetched or in flight
+                uint32_t budget = freeSlot.size() - fetchingCount;
+                if (budget == 0) {
+                    break;
+                }
+
+                uint32_t pending = (ring.sq_tail - ring.sq_head + ring.entries) % ring.entries;
+                uint32_t count = std::min<uint32_t>({pending, DMADescFetchBatch, ring.entries - ring.sq_head, budget});
+                uint64_t address = ring.sq_base + (ring.sq_head * DMADescriptorDW * 4);
+
+                DMA_read read = {};
+                read.type = DMAReadType::Descriptor;
+                read.address = address;
+                read.ring = r;
+                read.count = count;
+                read.length = count * DMADescriptorDW * 4;
+                read.data.resize(count * DMADescriptorDW, 0);
+                ring.fetching = true;
+                ring.sq_head = (ring.sq_head + count) % ring.entries;
+                fetchingCount += count;
+
+                issue_read(read);
+                SC_LOG(DEBUG, "fetch descriptor ring[%d]: address=0x%llx, count=%d", r, address, count);
+
+                fetchRing = (r + 1) % rings.size();
+                progress = true;
+            }
+        }
+    }
+}
+
+void PCIeDMAEngine::issue_read(DMA_read& read, uint8_t tc, uint8_t attr, uint8_t at)
+{
+    // completions find their read by tag, two reads of the same address stay apart
+    uint32_t id = nextReadID++;
+    outstandingRead[id] = read;
+    attr |= DMAIDOrdering ? PCIeAttrIDO : 0;
+    while (m_transactionLayer->send_read_TLP(read.address, read.length / 4, tc, attr, at, id, ring_function(read.ring)) != true) {
+        wait(5, sc_core::SC_NS);
+    }
+}
+
+void PCIeDMAEngine::receive_completion(const PCIeTLPHeader& header, std::vector<PCIeTLPPayload>* payloads)
+{
+    uint64_t address = get_tlp_address(header);
+    auto it = outstandingRead.find(m_transactionLayer->get_tag_context(header.tag));
+    if (it == outstandingRead.end() || address < it->second.address || address >= (it->second.address + it->second.length)) {
+        SC_LOG(ERROR, "unexpected completion, tag=%d, address=0x%llx", header.tag, address);
+        return;
+    }
+
+    DMA_read& read = it->second;
+    uint32_t offset = (address - read.address) / 4;
+    for (size_t i = 0; i < payloads->size() && (offset + i) < read.data.size(); i++) {
+        read.data[offset + i] = payloads->at(i).payload;
+    }
+    read.received += payloads->size() * 4;
+    SC_LOG(VERB, "receive completion: address=0x%llx, received=%d/%d", address, read.received, read.length);
+
+    if (read.received >= read.length) {
+        complete_read(read);
+        outstandingRead.erase(it);
+    }
+}
+
+void PCIeDMAEngine::complete_read(DMA_read& read)
+{
+    if (read.type == DMAReadType::Descriptor) {
+        DMARing& ring = rings[read.ring];
+        ring.fetching = false;
+        fetchingCount -= read.count;
+
+        for (uint32_t i = 0; i < read.count; i++) {
+            uint32_t *dw = &read.data[i * DMADescriptorDW];
+            uint32_t slot = freeSlot.front();
+            freeSlot.pop();
+
+            DMA_transaction& dma_trans = inflight[slot];
+            dma_trans.desc.address = (static_cast<uint64_t>(dw[1]) << 32) | dw[0];
+            dma_trans.desc.length = dw[2];
+            dma_trans.desc.id = dw[3] & 0xFFFF;
+            dma_trans.desc.control = dw[3] >> 16;
+            dma_trans.ring = read.ring;
+            dma_trans.issued = 0;
+            dma_trans.received = 0;
+            dma_trans.translating = false;
+            dma_trans.start_time = sc_core::sc_time_stamp();
+            inflight_valid[slot] = true;
+
+            segmentQueue.push(slot);
+            SC_LOG(DEBUG, "get descriptor: id=%d, address=0x%llx, length=%d, write=%d", dma_trans.desc.id, dma_trans.desc.address, dma_trans.desc.length, dma_trans.desc.control & DMADescCtrlWrite);
+        }
+        event_segment.notify();
+        event_doorbell.notify();
+    }
+
+    else {
+        DMA_transaction& dma_trans = inflight[read.slot];
+        dma_trans.received += read.length;
+        SC_LOG(VERB, "read data done: address=0x%llx, id=%d, received=%d/%d", read.address, dma_trans.desc.id, dma_trans.received, dma_trans.desc.length);
+
+        if (dma_trans.received >= dma_trans.desc.length && dma_trans.issued >= dma_trans.desc.length) {
+            completionQueue.push(read.slot);
+            event_completion.notify();
+        }
+    }
+}
+
+void PCIeDMAEngine::process_segment()
+{
+    while (true) {
+        if (!translationReady) {
+            wait(event_segment);
+        }
+        translationReady = false;
+
+        // descriptors parked on an ATC miss try again
+        while (!translationQueue.empty()) {
+            segmentQueue.push(translationQueue.front());
+            translationQueue.pop();
+        }
+
+        // round-robin one segment per in-flight descriptor, a miss parks only its own descriptor
+        while (!segmentQueue.empty()) {
+            uint32_t slot = segmentQueue.front();
+            segmentQueue.pop();
+
+            if (issue_segment(slot) != true) {
+                translationQueue.push(slot);
+                continue;
+            }
+
+            DMA_transaction& dma_trans = inflight[slot];
+            if (dma_trans.issued < dma_trans.desc.length) {
+                segmentQueue.push(slot);
+            }
+            else if (dma_trans.desc.control & DMADescCtrlWrite) {
+                // posted write is done once handed to transaction layer
+                completionQueue.push(slot);
+                event_completion.notify();
+            }
+        }
+    }
+}
+
+bool PCIeDMAEngine::issue_segment(uint32_t slot)
+{
+    DMA_transaction& dma_trans = inflight[slot];
+    bool write = dma_trans.desc.control & DMADescCtrlWrite;
+    uint8_t tc = (dma_trans.desc.control >> DMADescCtrlTCShift) & 0x7;
+    uint8_t attr = DMARelaxedOrdering ? PCIeAttrRelaxed : 0;
+    uint64_t address = dma_trans.desc.address + dma_trans.issued;
+    uint32_t remain = dma_trans.desc.length - dma_trans.issued;
+    uint32_t boundary = PCIeBoundarySize - (address % PCIeBoundarySize);
+    uint32_t length = std::min<uint32_t>({remain, boundary, write ? static_cast<uint32_t>(PCIeMaxPayloadSize) : static_cast<uint32_t>(PCIeMaxReadReqSize)});
+
+    // segment never crosses a page, one translation covers it
+    uint8_t at = PCIeATUntranslated;
+    if (ATSEnable) {
+        uint64_t translated;
+        ATCLookup result = m_atc->lookup(address, translated, dma_trans.translating);
+
+        // a refused Translation Request has no completion to wait for, send it again
+        while (result == ATCLookup::Retry) {
+            wait(5, sc_core::SC_NS);
+            result = m_atc->lookup(address, translated, true);
+        }
+        if (result == ATCLookup::Miss) {
+            dma_trans.translating = true;
+            return false;
+        }
+        dma_trans.translating = false;
+        address = translated;
+        at = PCIeATTranslated;
+    }
+
+    if (write) {
+        std::vector<PCIeTLPPayload> payloads(length / 4);
+        for (uint32_t dw = 0; dw < payloads.size(); dw++) {
+            payloads[dw].payload = (dma_trans.desc.id << 16) | ((dma_trans.issued / 4) + dw);
+        }
+        send_write(dma_trans.ring, address, &payloads, tc, attr, at);
+    }
+    else {
+        DMA_read read = {};
+        read.type = DMAReadType::Data;
+        read.address = address;
+        read.ring = dma_trans.ring;
+        read.slot = slot;
+        read.length = length;
+        issue_read(read, tc, attr, at);
+    }
+
+    dma_trans.issued += length;
+    profile_tlp_count++;
+    SC_LOG(VERB, "issue segment: id=%d, address=0x%llx, length=%d, write=%d", dma_trans.desc.id, address, length, write);
+    return true;
+}
+
+void PCIeDMAEngine::send_write(uint32_t ring, uint64_t address, std::vector<PCIeTLPPayload>* payloads, uint8_t tc, uint8_t attr, uint8_t at)
+{
+    attr |= DMAIDOrdering ? PCIeAttrIDO : 0;
+    while (m_transactionLayer->send_TLP(PCIeTLPType::MWr, payloads, address, tc, attr, at, ring_function(ring)) != true) {
+        wait(5, sc_core::SC_NS);
+    }
+}
+
+void PCIeDMAEngine::process_completion()
+{
+    while (true) {
+        wait(event_completion);
+
+        while (!completionQueue.empty()) {
+            uint32_t slot = completionQueue.front();
+            completionQueue.pop();
+
+            DMA_transaction& dma_trans = inflight[slot];
+            DMARing& ring = rings[dma_trans.ring];
+            uint8_t tc = (dma_trans.desc.control >> DMADescCtrlTCShift) & 0x7; // same TC keeps entry behind its data
+
+            // write completion entry
+            std::vector<PCIeTLPPayload> entry(DMACompletionDW);
+            entry[0].payload = dma_trans.desc.id;
+            entry[1].payload = dma_trans.desc.length;
+            entry[2].payload = ring.sq_head;
+            entry[3].payload = ring.cq_phase;
+            send_write(dma_trans.ring, ring.cq_base + (ring.cq_tail * DMACompletionDW * 4), &entry, tc);
+            ring.cq_tail++;
+            if (ring.cq_tail == ring.entries) {
+                ring.cq_tail = 0;
+                ring.cq_phase ^= 1;
+            }
+
+            // interrupt
+            if (DMAMSIXEnable && (dma_trans.desc.control & DMADescCtrlIRQ)) {
+                std::vector<PCIeTLPPayload> msix(1);
+                msix[0].payload = ring.msix_data;
+                send_write(dma_trans.ring, ring.msix_address, &msix, tc);
+                profile_msix_count++;
+            }
+
+            // profiling
+            profile_desc_count++;
+            profile_byte_size += dma_trans.desc.length;
+            profile_latency += (sc_core::sc_time_stamp() - dma_trans.start_time).to_seconds();
+            SC_LOG(TRACE, "finish descriptor: id=%d, length=%d", dma_trans.desc.id, dma_trans.desc.length);
+
+            if ((profile_desc_count % 1000) == 0) {
+                SC_LOG(INFO, "dma descriptor: %d, TLP: %d, MSI-X: %d, avg latency: %.2f ns", profile_desc_count, profile_tlp_count, profile_msix_count, (profile_latency / profile_desc_count) * 1e9);
+                m_transactionLayer->report_vc_stats();
+                m_transactionLayer->report_pipeline_stats();
+                PCIeInstrumentPolicy::report();
+                m_atc->report_stats();
+            }
+
+            inflight_valid[slot] = false;
+            freeSlot.push(slot);
+            event_doorbell.notify();
+        }
+    }
+}
+
+//  =================================
+//  DMAHostDriver Function Definition
+//  =================================
+
+void DMAHostDriver::set_iommu(PCIeIOMMU *iommu)
+{
+    m_iommu = iommu;
+}
+
+void DMAHostDriver::process_submit()
+{
+    // data buffer of each ring slot, 4 KB aligned after the rings
+    uint64_t buffer_base = ring.cq_base + (ring.entries * DMACompletionDW * 4);
+    buffer_base = (buffer_base + PCIeBoundarySize - 1) & ~static_cast<uint64_t>(PCIeBoundarySize - 1);
+    uint64_t buffer_size = DMAHostMaxLength + PCIeBoundarySize;
+
+    while (true) {
+        reap_completion();
+
+        // post descriptors while submission ring has room
+        bool posted = false;
+        while (((ring.sq_tail + 1) % ring.entries) != ring.sq_head && !busy[ring.sq_tail]) {
+            uint32_t slot = ring.sq_tail;
+            DMADescriptor desc;
+            desc.length = rand.nextInt() * 4;
+            desc.address = buffer_base + (slot * buffer_size) + (rand.nextInt(0, (PCIeBoundarySize / 4) - 1) * 4);
+            desc.id = slot;
+            desc.control = DMADescCtrlIRQ | (rand.nextInt(0, 1) ? DMADescCtrlWrite : 0) | ((trafficClass & 0x7) << DMADescCtrlTCShift);
+
+            uint64_t address = ring.sq_base + (slot * DMADescriptorDW * 4);
+            m_hostMemory->write_dw(address + 0, static_cast<uint32_t>(desc.address));
+            m_hostMemory->write_dw(address + 4, static_cast<uint32_t>(desc.address >> 32));
+            m_hostMemory->write_dw(address + 8, desc.length);
+            m_hostMemory->write_dw(address + 12, desc.id | (desc.control << 16));
+            SC_LOG(DEBUG, "post descriptor: id=%d, address=0x%llx, length=%d", desc.id, desc.address, desc.length);
+
+            busy[slot] = true;
+            submit_time[slot] = sc_core::sc_time_stamp();
+            submit_desc[slot] = desc;
+            ring.sq_tail = (ring.sq_tail + 1) % ring.entries;
+            posted = true;
+        }
+
+        if (posted) {
+            m_dmaEngine->ring_doorbell(ringID, ring.sq_tail);
+        }
+
+        wait(DMAHostPollInterval, sc_core::SC_NS);
+    }
+}
+
+void DMAHostDriver::reap_completion()
+{
+    while (true) {
+        uint64_t entry = ring.cq_base + (ring.cq_tail * DMACompletionDW * 4);
+        if (m_hostMemory->read_dw(entry + 12) != ring.cq_phase) {
+            break;
+        }
+
+        uint32_t id = m_hostMemory->read_dw(entry);
+        uint32_t length = m_hostMemory->read_dw(entry + 4);
+        ring.sq_head = m_hostMemory->read_dw(entry + 8);
+
+        profile_desc_count++;
+        profile_byte_size += length;
+        profile_latency += (sc_core::sc_time_stamp() - submit_time[id % ring.entries]).to_seconds();
+        busy[id % ring.entries] = false;
+        SC_LOG(VERB, "reap completion: id=%d, length=%d", id, length);
+
+        // strict mode unmaps the buffer, IOMMU shoots down device cached translation
+        if (IOMMUStrictInvalidate && m_iommu != nullptr) {
+            m_iommu->unmap(submit_desc[id % ring.entries].address, submit_desc[id % ring.entries].length);
+        }
+
+        if ((profile_desc_count % 1000) == 0) {
+            sc_core::sc_time elapse_time = sc_core::sc_time_stamp() - start_time;
+            SC_LOG(INFO, "dma throughput: %.2f GB/s, avg latency: %.2f ns", (profile_byte_size / 1e9) / elapse_time.to_seconds(), (profile_latency / profile_desc_count) * 1e9);
+            if (m_iommu != nullptr) {
+                m_iommu->report_stats();
+            }
+        }
+
+        ring.cq_tail++;
+        if (ring.cq_tail == ring.entries) {
+            ring.cq_tail = 0;
+            ring.cq_phase ^= 1;
+        }
+    }
+}
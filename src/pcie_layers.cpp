@@ -1,102 +1,384 @@
 #include "pcie_layers.hpp"
 #include <cassert>
+#include <limits>
+
+PCIeResourceConfig& pcie_resource_config()
+{
+    static PCIeResourceConfig config;
+    return config;
+}
 
 //  ========================================
 //  PCIeTransactionLayer Function Definition
 //  ========================================
 
-bool PCIeTransactionLayer::send_TLP(PCIeTLPType type, std::vector<PCIeTLPPayload>* payloads)
+bool PCIeTransactionLayer::send_TLP(PCIeTLPType type, std::vector<PCIeTLPPayload>* payloads, uint64_t address, uint8_t tc, uint8_t attr, uint8_t at, uint8_t func)
+{
+    TL_transaction tlp_trans = {};
+    tlp_trans.type = type;
+    tlp_trans.lengthDW = payloads->size();
+    tlp_trans.address = address;
+    tlp_trans.reqID = function_id(func);
+    tlp_trans.tc = tc;
+    tlp_trans.attr = attr;
+    tlp_trans.at = at;
+    return push_internalTrans(tlp_trans, payloads);
+}
+
+bool PCIeTransactionLayer::send_read_TLP(uint64_t address, uint32_t lengthDW, uint8_t tc, uint8_t attr, uint8_t at, uint32_t context, uint8_t func)
 {
-    int32_t vacc = (internalBufferHead - internalBufferTail + internalBufferSize - 1) % internalBufferSize;
-    if ((int)payloads->size() > vacc) {
+    TL_transaction tlp_trans = {};
+    tlp_trans.type = PCIeTLPType::MRd;
+    tlp_trans.lengthDW = lengthDW;
+    tlp_trans.address = address;
+    tlp_trans.reqID = function_id(func);
+    tlp_trans.tc = tc;
+    tlp_trans.attr = attr;
+    tlp_trans.at = at;
+    tlp_trans.context = context;
+    return push_internalTrans(tlp_trans, nullptr);
+}
+
+bool PCIeTransactionLayer::send_completion(const PCIeTLPHeader& request, uint64_t address, std::vector<PCIeTLPPayload>* payloads)
+{
+    TL_transaction tlp_trans = {};
+    tlp_trans.type = (payloads != nullptr && !payloads->empty()) ? PCIeTLPType::CplD : PCIeTLPType::Cpl;
+    tlp_trans.lengthDW = (payloads != nullptr) ? payloads->size() : 0;
+    tlp_trans.address = address;
+    tlp_trans.reqID = request.reqID;
+    tlp_trans.tag = request.tag;
+    tlp_trans.tc = request.TC; // completion keeps the TC and attributes of its request
+    tlp_trans.attr = get_tlp_attr(request);
+    tlp_trans.at = request.AT;  // echo AT so a translation completion can be told apart
+    return push_internalTrans(tlp_trans, payloads);
+}
+
+bool PCIeTransactionLayer::push_internalTrans(TL_transaction& tlp_trans, std::vector<PCIeTLPPayload>* payloads)
+{
+    if (functional) {
+        return send_functional(tlp_trans, payloads);
+    }
+
+    TL_virtualChannel& vc = vcs[tc_to_vc(tlp_trans.tc)];
+    int32_t payload_size = (payloads != nullptr) ? payloads->size() : 0;
+    int32_t vacc = (vc.internalBufferHead - vc.internalBufferTail + vc.internalBufferSize - 1) % vc.internalBufferSize;
+    if (payload_size > vacc) {
+        sendBlocked = true;
         return false;
     }
-    SC_LOG(VERB, "internalBufferHead=%d, internalBufferTail=%d, internalBufferSize=%d, payload_size=%d, vaccancy=%d", internalBufferHead, internalBufferTail, internalBufferSize, payloads->size(), vacc - payloads->size());
+    sendBlocked = false;
+    SC_LOG(VERB, "internalBufferHead=%d, internalBufferTail=%d, internalBufferSize=%d, payload_size=%d, vaccancy=%d", vc.internalBufferHead, vc.internalBufferTail, vc.internalBufferSize, payload_size, vacc - payload_size);
     SC_LOG(VERB, "allocate TLP internal buffer");
 
-    TL_transaction tlp_trans;
-    tlp_trans.type = type;
-    tlp_trans.length = payloads->size();
-    tlp_trans.internal_buffer_base = internalBufferTail;
+    tlp_trans.length = payload_size;
+    tlp_trans.internal_buffer_base = vc.internalBufferTail;
+    tlp_trans.buffer_seq = vc.internalBuffer_seq + vc.internalBuffer_alloc.size();
+    tlp_trans.timestamp = sc_core::sc_time_stamp();
+    PCIeChecksum checksum;
     for (size_t i = 0; i < tlp_trans.length; i++) {
-        internalBuffer[internalBufferTail++] = payloads->at(i).payload;
-        internalBufferTail %= internalBufferSize;
+        checksum.add(payloads->at(i).payload);
+        vc.internalBuffer[vc.internalBufferTail++] = payloads->at(i).payload;
+        vc.internalBufferTail %= vc.internalBufferSize;
     }
+    tlp_trans.checksum = checksum.value();
+    vc.internalBuffer_alloc.push_back({tlp_trans.length, false});
 
-    internalTrans_queue.push(tlp_trans);
+    vc.internalTrans_queue.push_back(tlp_trans);
     event_internalTrans.notify();
+    PCIE_HOOK(PCIeHook::SendTLP, static_cast<uint32_t>(tlp_trans.type), tc_to_vc(tlp_trans.tc), 0, 0, 1, tlp_trans.length);
     SC_LOG(VERB, "send_TLP done");
     return true;
 }
 
+bool PCIeTransactionLayer::internalTrans_pending(void)
+{
+    for (size_t vc = 0; vc < vcs.size(); vc++) {
+        if (!vcs[vc].internalTrans_queue.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PCIeTransactionLayer::TLP_is_ready(uint8_t vc, const TL_transaction& tlp_trans)
+{
+    if (!is_completion(tlp_trans.type) && tag_pool_is_empty()) {
+        return false;
+    }
+    return acquire_credits(vc, get_credit_type(tlp_trans.type), 1, tlp_trans.length);
+}
+
+uint16_t PCIeTransactionLayer::function_id(uint8_t func)
+{
+    // function number in BDF[2:0]
+    return (requesterID & ~0x7u) | (func & 0x7);
+}
+
+PCIeOrderingKey PCIeTransactionLayer::get_ordering_key(const TL_transaction& tlp_trans)
+{
+    // stream and requester IDs as they go out in the header
+    PCIeTLPHeader header;
+    build_header(tlp_trans, tlp_trans.tag, header);
+    PCIeOrderingKey key;
+    key.type = tlp_trans.type;
+    key.attr = tlp_trans.attr;
+    key.streamID = get_tlp_stream_id(header);
+    key.reqID = header.reqID;
+    key.tag = tlp_trans.tag;
+    return key;
+}
+
+bool PCIeTransactionLayer::TLP_may_bypass(uint8_t vc, size_t index)
+{
+    const std::deque<TL_transaction>& queue = vcs[vc].internalTrans_queue;
+    PCIeOrderingKey row = get_ordering_key(queue[index]);
+    for (size_t i = 0; i < index; i++) {
+        if (!ordering_may_pass(row, get_ordering_key(queue[i]), true)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PCIeTransactionLayer::vc_is_ready(uint8_t vc, size_t& index)
+{
+    // oldest TLP that has its resources and may pass every older TLP
+    const std::deque<TL_transaction>& queue = vcs[vc].internalTrans_queue;
+    size_t window = orderingEnable ? std::min<size_t>(queue.size(), TLOrderingWindow) : std::min<size_t>(queue.size(), 1);
+    for (size_t i = 0; i < window; i++) {
+        if (TLP_is_ready(vc, queue[i]) && (i == 0 || TLP_may_bypass(vc, i))) {
+            index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PCIeTransactionLayer::select_vc(uint8_t& vc, size_t& index)
+{
+    uint8_t count = vcs.size();
+
+    if (vcArbitration == PCIeVCArbitration::StrictPriority) {
+        for (int v = count - 1; v >= 0; v--) {
+            if (vc_is_ready(v, index)) {
+                vc = v;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    if (vcArbitration == PCIeVCArbitration::RoundRobin) {
+        for (uint8_t i = 1; i <= count; i++) {
+            uint8_t v = (lastVC + i) % count;
+            if (vc_is_ready(v, index)) {
+                vc = lastVC = v;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // weighted round-robin, stay on a VC until its grants run out
+    for (uint8_t round = 0; round < 2; round++) {
+        bool exhausted = false;
+        for (uint8_t i = 0; i < count; i++) {
+            uint8_t v = (lastVC + i) % count;
+            if (vc_is_ready(v, index)) {
+                if (vcs[v].grant > 0) {
+                    vcs[v].grant--;
+                    vc = lastVC = v;
+                    return true;
+                }
+                exhausted = true;
+            }
+        }
+
+        // a new round once every ready VC used up its grants, nothing ready keeps the round going
+        if (!exhausted) {
+            return false;
+        }
+        for (uint8_t v = 0; v < count; v++) {
+            vcs[v].grant = vcs[v].weight;
+        }
+    }
+    return false;
+}
+
 void PCIeTransactionLayer::process_build_TLP()
 {
     while (true) {
         wait(event_internalTrans);
-        while (!internalTrans_queue.empty()) {
-            SC_LOG(VERB, "processing next TLP internalTrans");
 
-            TL_transaction tlp_trans = internalTrans_queue.front();
-            internalTrans_queue.pop();
+        // TLP restored from a checkpoint while it waited for the replay buffer
+        while (pendingInsert && insert_pending_TLP() != true) {
+            wait(1, SC_NS);
+        }
+
+        while (internalTrans_pending()) {
+            SC_LOG(VERB, "processing next TLP internalTrans");
 
-            // acquire credit
-            uint32_t header_credit = 1;
-            uint32_t payload_credit = tlp_trans.length;
+            // arbitrate between VCs that have a TLP with credit and tag
+            uint8_t vc;
+            size_t index;
             SC_LOG(VERB, "attempt to acquire_credits...");
-            while (acquire_credits(header_credit, payload_credit) != true) {
+            if (select_vc(vc, index) != true) {
+                if constexpr (PCIeInstrumentPolicy::enabled) {
+                    if (!creditStalled) {
+                        PCIE_HOOK(PCIeHook::CreditStall);
+                        creditStalled = true;
+                    }
+                }
                 wait(1, SC_NS);
+                continue;
+            }
+            if constexpr (PCIeInstrumentPolicy::enabled) {
+                creditStalled = false;
             }
-            SC_LOG(VERB, "acquire_credits done");
+            SC_LOG(VERB, "acquire_credits done, vc=%d, index=%d", vc, index);
 
-            // acquire tag
-            SC_LOG(VERB, "attempt to acquire tag...");
-            while (tag_pool_is_empty() != false) {
-                wait(1, SC_NS);
+            TL_transaction tlp_trans = vcs[vc].internalTrans_queue[index];
+            vcs[vc].internalTrans_queue.erase(vcs[vc].internalTrans_queue.begin() + index);
+            if (index > 0) {
+                vcs[vc].profile_bypass_count++;
             }
-            SC_LOG(VERB, "tag pool check done");
+
+            PCIeCreditType credit_type = get_credit_type(tlp_trans.type);
+            uint32_t header_credit = 1;
+            uint32_t payload_credit = tlp_trans.length;
+
+            // completion reuses the tag of its request
+            bool tagged = !is_completion(tlp_trans.type);
 
             // allocate credit
-            if (allocate_credits(header_credit, payload_credit) != true) {
+            if (allocate_credits(vc, credit_type, header_credit, payload_credit) != true) {
                 assert(0);
             }
+            PCIE_HOOK(PCIeHook::CreditAcquire, static_cast<uint32_t>(credit_type), vc, 0, 0, header_credit, payload_credit);
             SC_LOG(VERB, "allocte credit done");
 
             // allocate tag
-            uint8_t tag;
-            if (allocate_tag(tag) != true) {
+            uint8_t tag = tlp_trans.tag;
+            if (tagged && allocate_tag(tag) != true) {
                 assert(0);
             }
             SC_LOG(VERB, "allocte tag done");
 
+            // non-posted request holds its tag until all completions return
+            if (is_non_posted(tlp_trans.type)) {
+                outstandingNP[tag] = (tlp_trans.type == PCIeTLPType::MRd || tlp_trans.type == PCIeTLPType::MRdLk) ? tlp_trans.lengthDW : 0;
+                tagContext[tag] = tlp_trans.context;
+            }
+
             // setup TLP header
-            PCIeTLPHeader header;
-            header.Length = tlp_trans.length;
-            header.reqID = requesterID;
-            header.tag = tag;
-            header.Type = static_cast<uint32_t>(tlp_trans.type);
+            build_header(tlp_trans, tag, pendingHeader);
             SC_LOG(VERB, "complete TLP header");
 
-            if (m_dataLinkLayer->insert_TLP(header, tlp_trans.internal_buffer_base) != 0) {
+            pendingTrans = tlp_trans;
+            pendingVC = vc;
+            pendingInsert = true;
+
+            // through the TL pipeline, the next TLP may start once this one's last beat went in
+            sc_core::sc_time issued;
+            sc_core::sc_time leave = txPipeline.pass(sc_time_stamp(), tlp_trans.length, &issued);
+            pendingFill = leave - issued;
+            if (issued > sc_time_stamp()) {
+                wait(issued - sc_time_stamp());
+            }
+            while (insert_pending_TLP() != true) {
                 wait(1, SC_NS);
             }
+        }
+    }
+}
+
+void PCIeTransactionLayer::build_header(const TL_transaction& tlp_trans, uint8_t tag, PCIeTLPHeader& header)
+{
+    header = {};
+    header.Length = tlp_trans.lengthDW;
+    header.reqID = tlp_trans.reqID;
+    header.cplID = is_completion(tlp_trans.type) ? requesterID : 0;
+    header.tag = tag;
+    header.TC = tlp_trans.tc;
+    set_tlp_attr(header, tlp_trans.attr);
+    header.AT = tlp_trans.at;
+    header.Type = static_cast<uint32_t>(tlp_trans.type);
+    header.Fmt = ((tlp_trans.length > 0) ? 0x2 : 0x0) | ((tlp_trans.address >> 32) ? 0x1 : 0x0);
+    set_tlp_address(header, tlp_trans.address);
+}
 
-            SC_LOG(TRACE, "send TLP, tag=%d", tag);
+bool PCIeTransactionLayer::send_functional(TL_transaction& tlp_trans, std::vector<PCIeTLPPayload>* payloads)
+{
+    // fast-forward, no internal buffer, credits or pipeline, the partner receives it right away
+    uint8_t tag = tlp_trans.tag;
+    if (is_non_posted(tlp_trans.type)) {
+        if (allocate_tag(tag) != true) {
+            sendBlocked = true;
+            return false;
         }
+        outstandingNP[tag] = (tlp_trans.type == PCIeTLPType::MRd || tlp_trans.type == PCIeTLPType::MRdLk) ? tlp_trans.lengthDW : 0;
+        tagContext[tag] = tlp_trans.context;
+    }
+    sendBlocked = false;
+
+    tlp_trans.length = (payloads != nullptr) ? payloads->size() : 0;
+    PCIeTLPHeader header;
+    build_header(tlp_trans, tag, header);
+    PCIE_HOOK(PCIeHook::SendTLP, static_cast<uint32_t>(tlp_trans.type), tc_to_vc(tlp_trans.tc), tag, 0, 1, tlp_trans.length);
+    if (tlp_trans.type == PCIeTLPType::MWr && m_dataLinkLayer->write_direct(tlp_trans.address, payloads)) {
+        return true;
     }
+    m_dataLinkLayer->transmit_functional(header, tc_to_vc(tlp_trans.tc), payloads);
+    return true;
 }
 
-bool PCIeTransactionLayer::acquire_credits(uint32_t header, uint32_t payload)
+void PCIeTransactionLayer::set_functional(bool enable)
 {
+    functional = enable;
+}
+
+bool PCIeTransactionLayer::tx_is_idle()
+{
+    return !pendingInsert && !internalTrans_pending();
+}
+
+bool PCIeTransactionLayer::insert_pending_TLP()
+{
+    TL_transaction& tlp_trans = pendingTrans;
+    uint8_t vc = pendingVC;
+    if (m_dataLinkLayer->insert_TLP(pendingHeader, vc, tlp_trans.internal_buffer_base, tlp_trans.length, tlp_trans.checksum, pendingFill) != 0) {
+        return false;
+    }
+    pendingInsert = false;
+    vcs[vc].internalBuffer_alloc[tlp_trans.buffer_seq - vcs[vc].internalBuffer_seq].second = true;
+    retire_internalBuffer(vc);
+
+    // profiling
+    double latency = (sc_core::sc_time_stamp() - tlp_trans.timestamp).to_seconds();
+    vcs[vc].profile_tlp_count++;
+    vcs[vc].profile_byte_size += (tlp_trans.length * 4);
+    vcs[vc].profile_latency += latency;
+    vcs[vc].profile_max_latency = std::max(vcs[vc].profile_max_latency, latency);
+    profile_latency_hist[std::min<size_t>((latency * 1e9) / TLLatencyHistBucket, TLLatencyHistSize - 1)]++;
+
+    SC_LOG(TRACE, "send TLP, tag=%d, vc=%d", pendingHeader.tag, vc);
+    return true;
+}
+
+bool PCIeTransactionLayer::acquire_credits(uint8_t vc, PCIeCreditType type, uint32_t header, uint32_t payload)
+{
+    PCIeTLPCredit& credits = vcs[vc].credits[static_cast<int>(type)];
     if (!(header <= credits.header && payload <= credits.payload)) {
         return false;
     }
-    SC_LOG(VERB, "acquire_credits, header=%d/%d, payload=%d/%d", header, credits.header, payload, credits.payload);
+    SC_LOG(VERB, "acquire_credits, vc=%d, type=%d, header=%d/%d, payload=%d/%d", vc, static_cast<int>(type), header, credits.header, payload, credits.payload);
     return true;
 }
 
-bool PCIeTransactionLayer::allocate_credits(uint32_t header, uint32_t payload)
+bool PCIeTransactionLayer::allocate_credits(uint8_t vc, PCIeCreditType type, uint32_t header, uint32_t payload)
 {
-    SC_LOG(VERB, "credits, header=%d/%d, payload=%d/%d", header, credits.header, payload, credits.payload);
+    PCIeTLPCredit& credits = vcs[vc].credits[static_cast<int>(type)];
+    SC_LOG(VERB, "credits, vc=%d, header=%d/%d, payload=%d/%d", vc, header, credits.header, payload, credits.payload);
     if (!(header <= credits.header && payload <= credits.payload)) {
         return false;
     } 
@@ -107,18 +389,113 @@ bool PCIeTransactionLayer::allocate_credits(uint32_t header, uint32_t payload)
     return true;
 }
 
-void PCIeTransactionLayer::release_credits(uint32_t header, uint32_t payload)
+void PCIeTransactionLayer::release_credits(uint8_t vc, PCIeCreditType type, uint32_t header, uint32_t payload)
 {
+    PCIeTLPCredit& credits = vcs[vc].credits[static_cast<int>(type)];
     credits.header += header;
     credits.payload += payload;
-    internalBufferHead = (internalBufferHead + payload) % internalBufferSize;
-    SC_LOG(VERB, "internalBuffer: head=%d, tail=%d", internalBufferHead, internalBufferTail);
+    SC_LOG(VERB, "release_credits, vc=%d, type=%d, header=%d, payload=%d", vc, static_cast<int>(type), credits.header, credits.payload);
+
+    vcs[vc].internalBuffer_released += payload;
+    retire_internalBuffer(vc);
+}
+
+void PCIeTransactionLayer::retire_internalBuffer(uint8_t vc)
+{
+    // TLPs may leave out of order, so returned credits free the internal buffer
+    // from the oldest allocation, and only once that TLP itself has been sent
+    TL_virtualChannel& channel = vcs[vc];
+    while (!channel.internalBuffer_alloc.empty() && channel.internalBuffer_alloc.front().second
+           && channel.internalBuffer_alloc.front().first <= channel.internalBuffer_released) {
+        channel.internalBuffer_released -= channel.internalBuffer_alloc.front().first;
+        channel.internalBufferHead = (channel.internalBufferHead + channel.internalBuffer_alloc.front().first) % channel.internalBufferSize;
+        channel.internalBuffer_alloc.pop_front();
+        channel.internalBuffer_seq++;
+    }
+    SC_LOG(VERB, "internalBuffer[vc%d]: head=%d, tail=%d", vc, channel.internalBufferHead, channel.internalBufferTail);
 }
 
 void PCIeTransactionLayer::set_credits(uint32_t header, uint32_t payload)
 {
-    credits.header = header;
-    credits.payload = payload;
+    // the budget is split evenly over the credit classes, then over the VCs
+    uint32_t share = vcs.size() * PCIeCreditTypeCount;
+    for (size_t vc = 0; vc < vcs.size(); vc++) {
+        for (int type = 0; type < PCIeCreditTypeCount; type++) {
+            vcs[vc].credits[type].header = header / share;
+            vcs[vc].credits[type].payload = payload / share;
+        }
+    }
+}
+
+void PCIeTransactionLayer::init_virtual_channel(uint32_t count)
+{
+    assert(count >= 1 && count <= PCIeMaxVCCount);
+    vcs.resize(count);
+    for (size_t vc = 0; vc < vcs.size(); vc++) {
+        TL_virtualChannel& channel = vcs[vc];
+        channel.internalBufferSize = pcie_resource_config().internalBufferSize / count;
+        channel.internalBufferHead = 0;
+        channel.internalBufferTail = 0;
+        channel.internalBuffer.resize(channel.internalBufferSize, 0x00);
+        channel.internalBuffer_seq = 0;
+        channel.internalBuffer_released = 0;
+        channel.weight = 1;
+        channel.grant = 1;
+        channel.profile_tlp_count = 0;
+        channel.profile_byte_size = 0;
+        channel.profile_latency = 0;
+        channel.profile_max_latency = 0;
+        channel.profile_bypass_count = 0;
+    }
+
+    // spread TC0~TC7 over the VCs, higher TC on higher VC
+    for (uint8_t tc = 0; tc < PCIeMaxVCCount; tc++) {
+        tcToVC[tc] = (tc * count) / PCIeMaxVCCount;
+    }
+    vcArbitration = PCIeVCArbitration::RoundRobin;
+    lastVC = 0;
+    orderingEnable = TLOrderingEnable;
+    SC_LOG(INFO, "init virtual channel: #%d", count);
+}
+
+uint8_t PCIeTransactionLayer::tc_to_vc(uint8_t tc)
+{
+    return tcToVC[tc % PCIeMaxVCCount];
+}
+
+void PCIeTransactionLayer::set_tc_vc_map(uint8_t tc, uint8_t vc)
+{
+    assert(tc < PCIeMaxVCCount && vc < vcs.size());
+    tcToVC[tc] = vc;
+}
+
+void PCIeTransactionLayer::set_vc_arbitration(PCIeVCArbitration arbitration)
+{
+    vcArbitration = arbitration;
+}
+
+void PCIeTransactionLayer::set_vc_weight(uint8_t vc, uint32_t weight)
+{
+    assert(vc < vcs.size() && weight > 0);
+    vcs[vc].weight = weight;
+    vcs[vc].grant = weight;
+}
+
+void PCIeTransactionLayer::report_vc_stats()
+{
+    double elapse = sc_core::sc_time_stamp().to_seconds();
+    for (size_t vc = 0; vc < vcs.size(); vc++) {
+        TL_virtualChannel& channel = vcs[vc];
+        if (channel.profile_tlp_count == 0) {
+            continue;
+        }
+        SC_LOG(INFO, "vc%d: TLP: %d, bandwidth: %.2f GB/s, avg latency: %.2f ns, max latency: %.2f ns, bypass: %d", vc, channel.profile_tlp_count, (channel.profile_byte_size / 1e9) / elapse, (channel.profile_latency / channel.profile_tlp_count) * 1e9, channel.profile_max_latency * 1e9, channel.profile_bypass_count);
+    }
+}
+
+void PCIeTransactionLayer::set_ordering_enable(bool enable)
+{
+    orderingEnable = enable;
 }
 
 void PCIeTransactionLayer::init_tag_pool(uint32_t count)
@@ -141,27 +518,317 @@ bool PCIeTransactionLayer::allocate_tag(uint8_t& tag)
 
     tag = tagPool.front();
     tagPool.pop();
+    PCIE_HOOK(PCIeHook::TagAllocate, 0, 0, tag);
     return true;
 }
 
 void PCIeTransactionLayer::release_tag(uint8_t tag)
 {
     tagPool.push(tag);
+    PCIE_HOOK(PCIeHook::TagRelease, 0, 0, tag);
+}
+
+uint32_t PCIeTransactionLayer::get_internalBuffer_dw(uint8_t vc, uint32_t index)
+{
+    return vcs[vc].internalBuffer[(index % vcs[vc].internalBufferSize)];
+}
+
+sc_core::sc_time PCIeTransactionLayer::receive_TLP(const PCIeTLPHeader& header, std::vector<PCIeTLPPayload>* payloads, uint8_t vc)
+{
+    PCIeTLPType type = static_cast<PCIeTLPType>(header.Type);
+    PCIE_HOOK(PCIeHook::Receive, header.Type, vc, header.tag, 0, 1, (payloads != nullptr) ? payloads->size() : 0);
+    profile_rx_byte_size += (payloads != nullptr) ? (payloads->size() * 4) : 0;
+    bool finished = false;
+    if (is_completion(type)) {
+        auto it = outstandingNP.find(header.tag);
+        if (it == outstandingNP.end()) {
+            SC_LOG(ERROR, "unexpected completion, tag=%d", header.tag);
+            assert(0);
+        }
+
+        uint32_t dw = (payloads != nullptr) ? payloads->size() : 0;
+        it->second = (dw >= it->second) ? 0 : (it->second - dw);
+        progress_completion++;
+        if (it->second == 0) {
+            outstandingNP.erase(it);
+            finished = true;
+        }
+    }
+
+    // handler returns how long the receive buffer entry is held before its credits return
+    sc_core::sc_time hold_time = rx_handler ? rx_handler(header, payloads) : SC_ZERO_TIME;
+
+    // tag context stays readable by the handler of the last completion
+    if (finished) {
+        tagContext.erase(header.tag);
+        release_tag(header.tag);
+        SC_LOG(TRACE, "finish non-posted TLP, tag=%d", header.tag);
+    }
+    return hold_time;
+}
+
+uint32_t PCIeTransactionLayer::get_tag_context(uint8_t tag)
+{
+    auto it = tagContext.find(tag);
+    return (it != tagContext.end()) ? it->second : 0;
+}
+
+void PCIeTransactionLayer::register_receive_TLP(std::function<sc_core::sc_time(const PCIeTLPHeader&, std::vector<PCIeTLPPayload>*)> handler)
+{
+    rx_handler = handler;
+}
+
+static void save_transaction(CheckpointWriter& writer, const TL_transaction& tlp_trans)
+{
+    writer.put(tlp_trans.type);
+    writer.put(tlp_trans.internal_buffer_base);
+    writer.put(tlp_trans.length);
+    writer.put(tlp_trans.lengthDW);
+    writer.put(tlp_trans.address);
+    writer.put(tlp_trans.reqID);
+    writer.put(tlp_trans.tag);
+    writer.put(tlp_trans.context);
+    writer.put(tlp_trans.tc);
+    writer.put(tlp_trans.attr);
+    writer.put(tlp_trans.at);
+    writer.put(tlp_trans.buffer_seq);
+    writer.put(tlp_trans.checksum);
+    writer.put_time(tlp_trans.timestamp);
+}
+
+static TL_transaction restore_transaction(CheckpointReader& reader)
+{
+    TL_transaction tlp_trans;
+    tlp_trans.type = reader.get<PCIeTLPType>();
+    tlp_trans.internal_buffer_base = reader.get<uint32_t>();
+    tlp_trans.length = reader.get<uint32_t>();
+    tlp_trans.lengthDW = reader.get<uint32_t>();
+    tlp_trans.address = reader.get<uint64_t>();
+    tlp_trans.reqID = reader.get<uint16_t>();
+    tlp_trans.tag = reader.get<uint8_t>();
+    tlp_trans.context = reader.get<uint32_t>();
+    tlp_trans.tc = reader.get<uint8_t>();
+    tlp_trans.attr = reader.get<uint8_t>();
+    tlp_trans.at = reader.get<uint8_t>();
+    tlp_trans.buffer_seq = reader.get<uint64_t>();
+    tlp_trans.checksum = reader.get<uint64_t>();
+    tlp_trans.timestamp = reader.get_time();
+    return tlp_trans;
+}
+
+void PCIeTransactionLayer::save(CheckpointWriter& writer)
+{
+    writer.section(name());
+    writer.put_queue(tagPool);
+    writer.put<uint32_t>(vcs.size());
+    for (TL_virtualChannel& vc : vcs) {
+        writer.put<uint32_t>(vc.internalTrans_queue.size());
+        for (const TL_transaction& tlp_trans : vc.internalTrans_queue) {
+            save_transaction(writer, tlp_trans);
+        }
+        writer.put_vector(vc.internalBuffer);
+        writer.put(vc.internalBufferHead);
+        writer.put(vc.internalBufferTail);
+        writer.put<uint32_t>(vc.internalBuffer_alloc.size());
+        for (const auto& alloc : vc.internalBuffer_alloc) {
+            writer.put(alloc.first);
+            writer.put(alloc.second);
+        }
+        writer.put(vc.internalBuffer_seq);
+        writer.put(vc.internalBuffer_released);
+        for (int type = 0; type < PCIeCreditTypeCount; type++) {
+            writer.put(vc.credits[type]);
+        }
+        writer.put(vc.weight);
+        writer.put(vc.grant);
+    }
+    writer.put(tcToVC);
+    writer.put(vcArbitration);
+    writer.put(lastVC);
+    writer.put(orderingEnable);
+    writer.put_map(outstandingNP);
+    writer.put_map(tagContext);
+    writer.put(pendingInsert);
+    writer.put(pendingVC);
+    save_transaction(writer, pendingTrans);
+    writer.put(pendingHeader);
+    writer.put<double>(pendingFill.to_seconds());
+}
+
+bool PCIeTransactionLayer::restore(CheckpointReader& reader)
+{
+    if (!reader.section(name())) {
+        return false;
+    }
+    reader.get_queue(tagPool);
+    if (reader.get<uint32_t>() != vcs.size()) {
+        SC_LOG(ERROR, "checkpoint has a different VC count");
+        return false;
+    }
+    for (TL_virtualChannel& vc : vcs) {
+        vc.internalTrans_queue.clear();
+        for (uint32_t count = reader.get<uint32_t>(); count > 0; count--) {
+            vc.internalTrans_queue.push_back(restore_transaction(reader));
+        }
+        if (!reader.get_vector(vc.internalBuffer, vc.internalBufferSize)) {
+            SC_LOG(ERROR, "checkpoint has a different internal buffer size");
+            return false;
+        }
+        vc.internalBufferHead = reader.get<int32_t>();
+        vc.internalBufferTail = reader.get<int32_t>();
+        vc.internalBuffer_alloc.clear();
+        for (uint32_t count = reader.get<uint32_t>(); count > 0; count--) {
+            uint32_t length = reader.get<uint32_t>();
+            vc.internalBuffer_alloc.push_back({length, reader.get<bool>()});
+        }
+        vc.internalBuffer_seq = reader.get<uint64_t>();
+        vc.internalBuffer_released = reader.get<uint32_t>();
+        for (int type = 0; type < PCIeCreditTypeCount; type++) {
+            vc.credits[type] = reader.get<PCIeTLPCredit>();
+        }
+        vc.weight = reader.get<uint32_t>();
+        vc.grant = reader.get<uint32_t>();
+    }
+    for (uint8_t& vc : tcToVC) {
+        vc = reader.get<uint8_t>();
+    }
+    vcArbitration = reader.get<PCIeVCArbitration>();
+    lastVC = reader.get<uint8_t>();
+    orderingEnable = reader.get<bool>();
+    reader.get_map(outstandingNP);
+    reader.get_map(tagContext);
+    pendingInsert = reader.get<bool>();
+    pendingVC = reader.get<uint8_t>();
+    pendingTrans = restore_transaction(reader);
+    pendingHeader = reader.get<PCIeTLPHeader>();
+    pendingFill = sc_core::sc_time(reader.get<double>(), SC_SEC);
+
+    if (pendingInsert || internalTrans_pending()) {
+        event_internalTrans.notify(SC_ZERO_TIME);
+    }
+    return reader.good();
+}
+
+bool PCIeTransactionLayer::has_pending_work()
+{
+    return sendBlocked || pendingInsert || internalTrans_pending() || !outstandingNP.empty();
+}
+
+uint64_t PCIeTransactionLayer::get_progress()
+{
+    uint64_t progress = progress_completion;
+    for (const TL_virtualChannel& channel : vcs) {
+        progress += channel.profile_tlp_count;
+    }
+    return progress;
+}
+
+sc_core::sc_time PCIeTransactionLayer::pass_rx_pipeline(uint32_t lengthDW)
+{
+    return rxPipeline.pass(sc_time_stamp(), lengthDW) - sc_time_stamp();
+}
+
+PCIeTLPCredit PCIeTransactionLayer::get_credits(uint8_t vc, PCIeCreditType type)
+{
+    return vcs[vc].credits[static_cast<int>(type)];
+}
+
+uint32_t PCIeTransactionLayer::get_internal_buffer_used()
+{
+    uint32_t used = 0;
+    for (const TL_virtualChannel& channel : vcs) {
+        used += (channel.internalBufferTail - channel.internalBufferHead + channel.internalBufferSize) % channel.internalBufferSize;
+    }
+    return used;
+}
+
+uint32_t PCIeTransactionLayer::get_internal_buffer_size()
+{
+    uint32_t size = 0;
+    for (const TL_virtualChannel& channel : vcs) {
+        size += channel.internalBufferSize;
+    }
+    return size;
+}
+
+uint32_t PCIeTransactionLayer::get_outstanding_NP()
+{
+    return outstandingNP.size();
+}
+
+double PCIeTransactionLayer::get_throughput()
+{
+    double byte_size = 0;
+    for (const TL_virtualChannel& channel : vcs) {
+        byte_size += channel.profile_byte_size;
+    }
+    double elapse = sc_core::sc_time_stamp().to_seconds();
+    return (elapse > 0) ? (byte_size / 1e9) / elapse : 0;
+}
+
+double PCIeTransactionLayer::get_rx_throughput()
+{
+    double elapse = sc_core::sc_time_stamp().to_seconds();
+    return (elapse > 0) ? (profile_rx_byte_size / 1e9) / elapse : 0;
+}
+
+double PCIeTransactionLayer::get_latency_mean()
+{
+    uint64_t count = 0;
+    double latency = 0;
+    for (const TL_virtualChannel& channel : vcs) {
+        count += channel.profile_tlp_count;
+        latency += channel.profile_latency;
+    }
+    return (count > 0) ? latency / count : 0;
 }
 
-uint32_t PCIeTransactionLayer::get_internalBuffer_dw(uint32_t index)
+double PCIeTransactionLayer::get_latency_percentile(double fraction)
 {
-    return internalBuffer[(index % internalBufferSize)];
+    uint64_t count = 0;
+    for (uint64_t bucket : profile_latency_hist) {
+        count += bucket;
+    }
+
+    // upper edge of the bucket holding the percentile
+    uint64_t seen = 0;
+    for (size_t i = 0; i < profile_latency_hist.size(); i++) {
+        seen += profile_latency_hist[i];
+        if (count > 0 && seen >= (fraction * count)) {
+            return (i + 1) * TLLatencyHistBucket * 1e-9;
+        }
+    }
+    return TLLatencyHistSize * TLLatencyHistBucket * 1e-9;
+}
+
+void PCIeTransactionLayer::dump_state()
+{
+    SC_LOG(ERROR, "free tag: %d/%d, outstanding non-posted: %d, pending insert: %d, send blocked: %d", tagPool.size(), pcie_resource_config().tagCount, outstandingNP.size(), pendingInsert, sendBlocked);
+    if (pendingInsert) {
+        SC_LOG(ERROR, "pending insert: vc=%d, type=%d, tag=%d, length=%d, replay buffer full", pendingVC, static_cast<int>(pendingTrans.type), pendingHeader.tag, pendingTrans.length);
+    }
+    if (!outstandingNP.empty()) {
+        SC_LOG(ERROR, "oldest outstanding non-posted: tag=%d, DW left=%d", outstandingNP.begin()->first, outstandingNP.begin()->second);
+    }
+    for (size_t vc = 0; vc < vcs.size(); vc++) {
+        TL_virtualChannel& channel = vcs[vc];
+        SC_LOG(ERROR, "vc%d: queue=%d, internal buffer head=%d, tail=%d, size=%d, credit P=%d/%d, NP=%d/%d, Cpl=%d/%d", vc, channel.internalTrans_queue.size(), channel.internalBufferHead, channel.internalBufferTail, channel.internalBufferSize,
+            channel.credits[0].header, channel.credits[0].payload, channel.credits[1].header, channel.credits[1].payload, channel.credits[2].header, channel.credits[2].payload);
+        if (!channel.internalTrans_queue.empty()) {
+            const TL_transaction& head = channel.internalTrans_queue.front();
+            SC_LOG(ERROR, "vc%d head TLP: type=%d, length=%d, waiting %.2f ns", vc, static_cast<int>(head.type), head.length, (sc_core::sc_time_stamp() - head.timestamp).to_seconds() * 1e9);
+        }
+    }
 }
 
 //  =====================================
 //  PCIeDataLinkLayer Function Definition
 //  =====================================
 
-int PCIeDataLinkLayer::insert_TLP(PCIeTLPHeader header, uint32_t payload_index)
+int PCIeDataLinkLayer::insert_TLP(PCIeTLPHeader header, uint8_t vc, uint32_t payload_index, uint32_t payload_length, uint64_t checksum, sc_core::sc_time tl_fill)
 {
     int32_t header_credit = 1;
-    int32_t payload_credit = header.Length;
+    int32_t payload_credit = payload_length;
 
     int32_t header_vacc = (replayBufferHeader_head - replayBufferHeader_tail + seqNumCount - 1) % seqNumCount;
     SC_LOG(VERB, "replayBufferHeader_head=%d, replayBufferHeader_tail=%d, seqNumCount=%d, header_credit=%d, vaccancy=%d", replayBufferHeader_head, replayBufferHeader_tail, seqNumCount, header_credit, header_vacc);
@@ -176,12 +843,16 @@ int PCIeDataLinkLayer::insert_TLP(PCIeTLPHeader header, uint32_t payload_index)
     }
 
     SC_LOG(VERB, "insert TLP payload allocate done, header=%d, payload=%d", header_credit, payload_credit);
+    PCIE_HOOK(PCIeHook::InsertTLP, header.Type, vc, header.tag, 0, header_credit, payload_credit);
 
     DLL_transaction dll_trans;
     dll_trans.replayBufferHeader_base = replayBufferHeader_tail;
     dll_trans.headerLength = header_credit;
     dll_trans.replayBufferPayload_base = replayBufferPayload_tail;
     dll_trans.payloadLength = payload_credit;
+    dll_trans.checksum = checksum;
+    dll_trans.vc = vc;
+    dll_trans.tlFill = tl_fill.to_seconds() * 1e9;
       
     for (size_t i = 0; i < dll_trans.headerLength; i++) {
         replayBuffer_header[replayBufferHeader_tail++] = header;
@@ -190,7 +861,7 @@ int PCIeDataLinkLayer::insert_TLP(PCIeTLPHeader header, uint32_t payload_index)
 
     // PCIeTLPPayload tlp_payload;
     for (size_t i = 0; i < dll_trans.payloadLength; i++) {
-        replayBuffer_payload[replayBufferPayload_tail++] = {m_transactionLayer->get_internalBuffer_dw(payload_index + i)};
+        replayBuffer_payload[replayBufferPayload_tail++] = {m_transactionLayer->get_internalBuffer_dw(vc, payload_index + i)};
         replayBufferPayload_tail %= seqNumCount;
     }
 
@@ -220,16 +891,21 @@ void PCIeDataLinkLayer::peq_callback(tlm::tlm_generic_payload& trans, const tlm:
     if (phase == tlm::BEGIN_REQ) {
         auto tlp_ext = trans.get_extension<PCIeTLPExtension>();
         SC_LOG(VERB, "Get TLP: SeqNum=%d", tlp_ext->tlp.dll_header.seqNum);
+        aspm_receive();
 
         std::vector<PCIeTLPPayload> *payloads = tlp_ext->tlp.payloads;
-        for (size_t i = 0; i < tlp_ext->tlp.tlp_header.Length; i++) {
+        for (size_t i = 0; i < payloads->size(); i++) {
             SC_LOG(VERB, "Get TLP: data[%d]: %d", i, payloads->at(i).payload);
         }
+        if (m_scoreboard != nullptr) {
+            m_scoreboard->check(this, tlp_ext->tlp.dll_header.seqNum, tlp_ext->tlp.tlp_header, payloads);
+        }
+        PCIE_HOOK(PCIeHook::Receive, tlp_ext->tlp.tlp_header.Type, tlp_ext->vc, tlp_ext->tlp.tlp_header.tag, tlp_ext->tlp.dll_header.seqNum, 1, payloads->size());
         
         // create TLM transaction
         tlm::tlm_generic_payload* dllp_trans = new tlm::tlm_generic_payload();
         tlm::tlm_phase dllp_phase = tlm::BEGIN_RESP;
-        sc_time dllp_delay = sc_core::sc_time(10, SC_NS);
+        sc_time dllp_delay = sc_core::sc_time(DLLPFlightTime, SC_NS) + aspm_wake(SC_ZERO_TIME, false);
 
         // create TLP extension for TLM
         auto* dllp_ext = new PCIeDLLPExtension();
@@ -238,48 +914,61 @@ void PCIeDataLinkLayer::peq_callback(tlm::tlm_generic_payload& trans, const tlm:
         dllp_trans->set_extension(dllp_ext);
 
         s_out->nb_transport_fw(*dllp_trans, dllp_phase, dllp_delay);
+        lastDLLPTime = std::max(lastDLLPTime, sc_time_stamp() + dllp_delay);
         SC_LOG(VERB, "Send DLLP[AckNack] back");
 
-        // create TLM transaction
-        tlm::tlm_generic_payload* dllp_trans_fc = new tlm::tlm_generic_payload();
-        tlm::tlm_phase dllp_phase_fc = tlm::BEGIN_RESP;
-        sc_time dllp_delay_fc = sc_core::sc_time(10, SC_NS);
-
-        // create TLP extension for TLM
-        auto* dllp_ext_fc = new PCIeDLLPExtension();
-        dllp_ext_fc->fc = tlp_ext->tlp.tlp_header.Length;
-        dllp_ext_fc->dllp_type = PCIeDLLPType::UpdateFC;
-        dllp_trans_fc->set_extension(dllp_ext_fc);
+        // deliver TLP to transaction layer once through its receive pipeline
+        sc_time tl_delay = (m_transactionLayer != nullptr) ? m_transactionLayer->pass_rx_pipeline(payloads->size()) : SC_ZERO_TIME;
+        if (tl_delay > SC_ZERO_TIME) {
+            rxDeliveryPending++;
+            peq_notify(trans, tlm::END_REQ, tl_delay);
+        }
+        else {
+            deliver_TLP(trans);
+        }
+    }
 
-        s_out->nb_transport_fw(*dllp_trans_fc, dllp_phase_fc, dllp_delay_fc);
-        SC_LOG(VERB, "Send DLLP[UpdateFC] back");
+    else if (phase == tlm::END_REQ) {
+        rxDeliveryPending--;
+        deliver_TLP(trans);
     }
 
     else if (phase == tlm::BEGIN_RESP) {
         auto dllp_ext = trans.get_extension<PCIeDLLPExtension>();
+        aspm_receive();
 
         if (dllp_ext->dllp_type== PCIeDLLPType::AckNack) {
             uint32_t seqNum = dllp_ext->seqNum;
             SC_LOG(VERB, "Get DLLP[AckNack]: SeqNum=%d, Ack", seqNum);
 
             // release replay buffer according to seqNum
-            PCIeTLPHeader old_header = replayBuffer_header[seqNum];
+            DLL_transaction old_trans = DLLTrans_map[seqNum];
+            DLLTrans_map.erase(seqNum);
+            PCIeTLPHeader old_header = replayBuffer_header[old_trans.replayBufferHeader_base];
             uint8_t old_tag = old_header.tag;
             seqNumPool.push(seqNum); // release seqNum
+            progress_ack++;
+            PCIE_HOOK(PCIeHook::Ack, old_header.Type, old_trans.vc, old_tag, seqNum, old_trans.headerLength, old_trans.payloadLength);
 
             // release replay buffer
-            replayBufferHeader_head = (replayBufferHeader_head + 1) % seqNumCount; 
-            replayBufferPayload_head = (replayBufferPayload_head + old_header.Length) % seqNumCount;
-            m_transactionLayer->release_tag(old_tag);
+            replayBufferHeader_head = (replayBufferHeader_head + old_trans.headerLength) % seqNumCount; 
+            replayBufferPayload_head = (replayBufferPayload_head + old_trans.payloadLength) % seqNumCount;
+
+            // posted TLP is done once acked, non-posted waits for its completion
+            if (is_posted(static_cast<PCIeTLPType>(old_header.Type))) {
+                m_transactionLayer->release_tag(old_tag);
+                SC_LOG(TRACE, "finish TLP, tag=%d", old_tag);
+            }
             SC_LOG(VERB, "release replay buffer & tag(%d)", old_tag);
-            SC_LOG(TRACE, "finish TLP, tag=%d", old_tag);
         }
 
         else if (dllp_ext->dllp_type == PCIeDLLPType::UpdateFC) {
             uint32_t fc = dllp_ext->fc;
-            SC_LOG(VERB, "Get DLLP[UpdateFC]: fc=%d", fc);
+            uint8_t vc = dllp_ext->dllp.header.VC;
+            SC_LOG(VERB, "Get DLLP[UpdateFC]: vc=%d, type=%d, fc=%d", vc, static_cast<int>(dllp_ext->fc_type), fc);
 
-            m_transactionLayer->release_credits(1, fc);
+            m_transactionLayer->release_credits(vc, dllp_ext->fc_type, dllp_ext->fc_header, fc);
+            PCIE_HOOK(PCIeHook::UpdateFC, static_cast<uint32_t>(dllp_ext->fc_type), vc, 0, 0, dllp_ext->fc_header, fc);
             SC_LOG(VERB, "release credit");
         }
 
@@ -305,6 +994,13 @@ void PCIeDataLinkLayer::process_DLLTrans_queue()
         wait(event_DLLTrans_queue);
 
         while(!DLLTrans_queue.empty()) {
+                // hold the next TLP while a checkpoint drains the link
+                while (txPaused) {
+                    txParked = true;
+                    wait(event_txResume);
+                }
+                txParked = false;
+
                 DLL_transaction DLL_trans = DLLTrans_queue.front();
 
                 // acquire seqNum and write to replay buffer
@@ -330,28 +1026,386 @@ void PCIeDataLinkLayer::process_DLLTrans_queue()
                 tlp_ext->tlp.tlp_header = replayBuffer_header[DLL_trans.replayBufferHeader_base];
                 tlp_ext->tlp.payloads = payloads;
                 tlp_ext->tlp.lcrc = 0x12345678;
+                tlp_ext->vc = DLL_trans.vc;
+                tlp_ext->relaxed = tlp_ext->tlp.tlp_header.Attr0 & PCIeAttrRelaxed;
+                tlp_ext->no_snoop = tlp_ext->tlp.tlp_header.Attr0 & PCIeAttrNoSnoop;
                 trans->set_extension(tlp_ext);
                 SC_LOG(VERB, "TLP extension done");
 
-                wait(DLL_trans.payloadLength * 2, SC_NS); // simulate transaction latency of requester's physical layer to completer's physical layter 
+                // a link in L0s / L1 retrains before the TLP goes out
+                sc_core::sc_time wire = sc_core::sc_time(DLL_trans.payloadLength * LinkNsPerDW, SC_NS); // simulate transaction latency of requester's physical layer to completer's physical layter 
+                sc_core::sc_time exit = aspm_wake(wire, true);
+                if (exit > SC_ZERO_TIME) {
+                    wait(exit);
+                }
+
+                // the slower of DLL pipeline and wire paces the link, both pipeline fills and the flight ride on the annotated delay
+                sc_core::sc_time issued;
+                sc_core::sc_time leave = txPipeline.pass(sc_time_stamp(), DLL_trans.payloadLength, &issued);
+                wait(std::max(wire, issued - sc_time_stamp()));
+                delay = sc_core::sc_time(LinkFlightTime, SC_NS) + (leave - issued) + sc_core::sc_time(DLL_trans.tlFill, SC_NS);
+                if (m_scoreboard != nullptr) {
+                    m_scoreboard->expect(this, seqNum, tlp_ext->tlp.tlp_header, DLL_trans.payloadLength, DLL_trans.checksum);
+                }
+
+                DLLTrans_map[seqNum] = DLL_trans;
+                PCIE_HOOK(PCIeHook::Transmit, tlp_ext->tlp.tlp_header.Type, DLL_trans.vc, tlp_ext->tlp.tlp_header.tag, seqNum, DLL_trans.headerLength, DLL_trans.payloadLength);
                 s_out->nb_transport_fw(*trans, phase, delay);
+                progress_tlp_sent++;
                 SC_LOG(VERB, "DLLP send done");
 
                 DLLTrans_queue.pop();
-                DLLTrans_map[seqNum] = DLL_trans;
         }
     }
 }
 
+void PCIeDataLinkLayer::init_rx_credits(uint32_t vc_count)
+{
+    rxCredits.resize(vc_count);
+    for (auto& channel : rxCredits) {
+        for (DLL_rxCredit& rx : channel) {
+            rx.capacity = {pcie_resource_config().credits / (vc_count * PCIeCreditTypeCount), pcie_resource_config().credits / (vc_count * PCIeCreditTypeCount)};
+            rx.held = {0, 0};
+            rx.freed = {0, 0};
+            rx.drainFree = SC_ZERO_TIME;
+            rx.freedSince = SC_ZERO_TIME;
+            rx.profile_max_held = 0;
+        }
+    }
+}
+
+void PCIeDataLinkLayer::receive_credits(uint8_t vc, PCIeCreditType type, uint32_t payload, sc_core::sc_time hold_time)
+{
+    DLL_rxCredit& rx = rxCredits[vc][static_cast<int>(type)];
+    rx.held.header += 1;
+    rx.held.payload += payload;
+    rx.profile_max_held = std::max(rx.profile_max_held, rx.held.payload);
+    if (rx.held.header > rx.capacity.header || rx.held.payload > rx.capacity.payload) {
+        SC_LOG(ERROR, "rx vc%d: credit overrun, held %d/%d of %d/%d", vc, rx.held.header, rx.held.payload, rx.capacity.header, rx.capacity.payload);
+    }
+
+    // freed once the receiver let go of it and, with a fixed drain, once the class drained it in order
+    sc_core::sc_time free_time = sc_time_stamp() + hold_time;
+    if (RxDrainMode == RxDrainFixed) {
+        sc_core::sc_time start = std::max(sc_time_stamp(), rx.drainFree);
+        rx.drainFree = start + sc_core::sc_time(RxDrainHeaderNs + (static_cast<double>(payload) / RxDrainDWPerNs), SC_NS);
+        free_time = std::max(free_time, rx.drainFree);
+    }
+
+    DLL_rxRelease release;
+    release.time = free_time;
+    release.seq = rxReleaseSeq++;
+    release.vc = vc;
+    release.type = type;
+    release.payload = payload;
+    rxRelease.push(release);
+    event_rxDrain.notify();
+}
+
+bool PCIeDataLinkLayer::update_FC_is_due(const DLL_rxCredit& rx)
+{
+    if (rx.freed.header == 0) {
+        return false;
+    }
+    if (rx.freed.header >= UpdateFCHeaderThreshold || rx.freed.payload >= UpdateFCPayloadThreshold) {
+        return true;
+    }
+
+    // transmitter may be blocked: what it can still use is short of a max size TLP
+    uint32_t header_left = rx.capacity.header > rx.held.header ? rx.capacity.header - rx.held.header : 0;
+    uint32_t payload_left = rx.capacity.payload > rx.held.payload ? rx.capacity.payload - rx.held.payload : 0;
+    if (header_left < 1 || payload_left < (PCIeMaxPayloadSize / 4)) {
+        return true;
+    }
+    return sc_time_stamp() >= rx.freedSince + sc_core::sc_time(UpdateFCTimer, SC_NS);
+}
+
+void PCIeDataLinkLayer::send_update_FC(uint8_t vc, PCIeCreditType type)
+{
+    DLL_rxCredit& rx = rxCredits[vc][static_cast<int>(type)];
+
+    // create TLM transaction
+    tlm::tlm_generic_payload* dllp_trans_fc = new tlm::tlm_generic_payload();
+    tlm::tlm_phase dllp_phase_fc = tlm::BEGIN_RESP;
+    sc_time dllp_delay_fc = sc_core::sc_time(DLLPFlightTime, SC_NS) + aspm_wake(SC_ZERO_TIME, false);
+
+    // create TLP extension for TLM
+    auto* dllp_ext_fc = new PCIeDLLPExtension();
+    dllp_ext_fc->fc = rx.freed.payload;
+    dllp_ext_fc->fc_header = rx.freed.header;
+    dllp_ext_fc->fc_type = type;
+    dllp_ext_fc->dllp.header.VC = vc;
+    dllp_ext_fc->dllp_type = PCIeDLLPType::UpdateFC;
+    dllp_trans_fc->set_extension(dllp_ext_fc);
+
+    s_out->nb_transport_fw(*dllp_trans_fc, dllp_phase_fc, dllp_delay_fc);
+    lastDLLPTime = std::max(lastDLLPTime, sc_time_stamp() + dllp_delay_fc);
+    SC_LOG(VERB, "Send DLLP[UpdateFC] back, vc=%d, type=%d, header=%d, payload=%d", vc, static_cast<int>(type), rx.freed.header, rx.freed.payload);
+
+    rx.held.header -= rx.freed.header;
+    rx.held.payload -= rx.freed.payload;
+    rx.freed = {0, 0};
+    profile_update_fc_count++;
+}
+
+void PCIeDataLinkLayer::process_rx_drain()
+{
+    while (true) {
+        // retire drained entries
+        while (!rxRelease.empty() && rxRelease.top().time <= sc_time_stamp()) {
+            DLL_rxRelease release = rxRelease.top();
+            rxRelease.pop();
+            DLL_rxCredit& rx = rxCredits[release.vc][static_cast<int>(release.type)];
+            if (rx.freed.header == 0) {
+                rx.freedSince = sc_time_stamp();
+            }
+            rx.freed.header += 1;
+            rx.freed.payload += release.payload;
+        }
+
+        // UpdateFC per credit class, next wake is the earliest release or UpdateFC timer
+        bool waiting = !rxRelease.empty();
+        sc_core::sc_time next = waiting ? rxRelease.top().time : SC_ZERO_TIME;
+        for (size_t vc = 0; vc < rxCredits.size(); vc++) {
+            for (int type = 0; type < PCIeCreditTypeCount; type++) {
+                DLL_rxCredit& rx = rxCredits[vc][type];
+                if (update_FC_is_due(rx)) {
+                    send_update_FC(vc, static_cast<PCIeCreditType>(type));
+                }
+                else if (rx.freed.header > 0) {
+                    sc_core::sc_time timer = rx.freedSince + sc_core::sc_time(UpdateFCTimer, SC_NS);
+                    next = waiting ? std::min(next, timer) : timer;
+                    waiting = true;
+                }
+            }
+        }
+
+        if (waiting) {
+            wait(next - sc_time_stamp(), event_rxDrain);
+        }
+        else {
+            wait(event_rxDrain);
+        }
+    }
+}
+
+bool PCIeDataLinkLayer::rx_is_drained()
+{
+    if (!rxRelease.empty()) {
+        return false;
+    }
+    for (const auto& channel : rxCredits) {
+        for (const DLL_rxCredit& rx : channel) {
+            if (rx.held.header > 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static std::string pipeline_stats(const char* label, const PCIePipeline& pipeline)
+{
+    if (pipeline.profile_count == 0) {
+        return format_message("%s pipeline: idle", label);
+    }
+    double elapse = sc_core::sc_time_stamp().to_seconds();
+    return format_message("%s pipeline: TLP: %d, utilization: %.2f%%, avg stall: %.2f ns, avg latency: %.2f ns", label, pipeline.profile_count, (pipeline.profile_occupancy / elapse) * 100, (pipeline.profile_stall / pipeline.profile_count) * 1e9, (pipeline.profile_latency / pipeline.profile_count) * 1e9);
+}
+
+void PCIeTransactionLayer::report_pipeline_stats()
+{
+    SC_LOG(VERB, "%s", pipeline_stats("tx", txPipeline).c_str());
+    SC_LOG(VERB, "%s", pipeline_stats("rx", rxPipeline).c_str());
+}
+
+void PCIeDataLinkLayer::report_pipeline_stats()
+{
+    SC_LOG(VERB, "%s", pipeline_stats("tx", txPipeline).c_str());
+    SC_LOG(VERB, "%s", pipeline_stats("rx", rxPipeline).c_str());
+}
+
+PCIeASPMState PCIeDataLinkLayer::aspm_state(const sc_core::sc_time& now)
+{
+    if (now < aspmTxIdle) {
+        return PCIeASPMState::L0;
+    }
+    if ((ASPMControl & ASPML1) && now >= std::max(aspmTxIdle, aspmRxLast) + sc_core::sc_time(ASPML1IdleTime, SC_NS)) {
+        return PCIeASPMState::L1;
+    }
+    if ((ASPMControl & ASPML0s) && now >= aspmTxIdle + sc_core::sc_time(ASPML0sIdleTime, SC_NS)) {
+        return PCIeASPMState::L0s;
+    }
+    return PCIeASPMState::L0;
+}
+
+void PCIeDataLinkLayer::aspm_account(const sc_core::sc_time& now)
+{
+    if (now <= aspmAccounted) {
+        return;
+    }
+
+    // L0 until the L0s timer, L0s until the L1 timer, L1 until now
+    double from = aspmAccounted.to_seconds();
+    double to = now.to_seconds();
+    double never = std::numeric_limits<double>::infinity();
+    double l1 = (ASPMControl & ASPML1) ? (std::max(aspmTxIdle, aspmRxLast).to_seconds() + (ASPML1IdleTime * 1e-9)) : never;
+    double l0s = (ASPMControl & ASPML0s) ? std::min(l1, aspmTxIdle.to_seconds() + (ASPML0sIdleTime * 1e-9)) : l1;
+    auto overlap = [from, to](double begin, double end) { return std::max(0.0, std::min(end, to) - std::max(begin, from)); };
+
+    double in_l1 = overlap(l1, never);
+    double in_l0s = overlap(l0s, l1);
+    profile_aspm_residency[static_cast<int>(PCIeASPMState::L1)] += in_l1;
+    profile_aspm_residency[static_cast<int>(PCIeASPMState::L0s)] += in_l0s;
+    profile_aspm_residency[static_cast<int>(PCIeASPMState::L0)] += (to - from) - in_l1 - in_l0s;
+    aspmAccounted = now;
+}
+
+// exit latency the next TLP / DLLP pays, the transmitter then stays busy for another busy
+sc_core::sc_time PCIeDataLinkLayer::aspm_wake(const sc_core::sc_time& busy, bool tlp)
+{
+    sc_core::sc_time now = sc_time_stamp();
+    if (ASPMControl == ASPMDisabled || functional) {
+        aspmTxIdle = std::max(aspmTxIdle, now + busy);
+        return SC_ZERO_TIME;
+    }
+
+    aspm_account(now);
+    sc_core::sc_time exit = SC_ZERO_TIME;
+    PCIeASPMState state = aspm_state(now);
+    if (now < aspmReady) {
+        exit = aspmReady - now;     // joins a retraining already under way
+    }
+    else if (state != PCIeASPMState::L0) {
+        exit = sc_core::sc_time((state == PCIeASPMState::L1) ? ASPML1ExitLatency : ASPML0sExitLatency, SC_NS);
+        aspmReady = now + exit;
+        aspmAccounted = aspmReady;
+        profile_aspm_exit[static_cast<int>(state)]++;
+        profile_aspm_residency[static_cast<int>(PCIeASPMState::Exit)] += exit.to_seconds();
+        SC_LOG(DEBUG, "ASPM exit from %s, %.2f ns", (state == PCIeASPMState::L1) ? "L1" : "L0s", exit.to_seconds() * 1e9);
+    }
+    aspmTxIdle = std::max(aspmTxIdle, now + exit + busy);
+
+    // profiling
+    if (tlp) {
+        profile_aspm_tlp_count++;
+        if (exit > SC_ZERO_TIME) {
+            profile_aspm_tlp_delayed++;
+            profile_aspm_penalty += exit.to_seconds();
+            profile_aspm_max_penalty = std::max(profile_aspm_max_penalty, exit.to_seconds());
+        }
+    }
+    else if (exit > SC_ZERO_TIME) {
+        profile_aspm_dllp_delayed++;
+    }
+    return exit;
+}
+
+// the link partner woke an L1 link, this direction retrained along with it
+void PCIeDataLinkLayer::aspm_receive()
+{
+    sc_core::sc_time now = sc_time_stamp();
+    if (ASPMControl == ASPMDisabled || functional) {
+        return;
+    }
+    aspm_account(now);
+    if (aspm_state(now) == PCIeASPMState::L1) {
+        aspmTxIdle = now;
+    }
+    aspmRxLast = std::max(aspmRxLast, now);
+}
+
+void PCIeDataLinkLayer::report_aspm_stats()
+{
+    if (ASPMControl == ASPMDisabled) {
+        return;
+    }
+    aspm_account(sc_time_stamp());
+    double total = 0;
+    for (double residency : profile_aspm_residency) {
+        total += residency;
+    }
+    if (total <= 0) {
+        return;
+    }
+    SC_LOG(INFO, "ASPM residency L0: %.2f%%, L0s: %.2f%%, L1: %.2f%%, exit: %.2f%%",
+           (profile_aspm_residency[static_cast<int>(PCIeASPMState::L0)] / total) * 100, (profile_aspm_residency[static_cast<int>(PCIeASPMState::L0s)] / total) * 100,
+           (profile_aspm_residency[static_cast<int>(PCIeASPMState::L1)] / total) * 100, (profile_aspm_residency[static_cast<int>(PCIeASPMState::Exit)] / total) * 100);
+    SC_LOG(INFO, "ASPM exit L0s: %d, L1: %d, TLP delayed: %d/%d, avg penalty: %.2f ns per TLP, %.2f ns per delayed TLP, max: %.2f ns, DLLP delayed: %d",
+           profile_aspm_exit[static_cast<int>(PCIeASPMState::L0s)], profile_aspm_exit[static_cast<int>(PCIeASPMState::L1)], profile_aspm_tlp_delayed, profile_aspm_tlp_count,
+           (profile_aspm_tlp_count > 0) ? (profile_aspm_penalty / profile_aspm_tlp_count) * 1e9 : 0, (profile_aspm_tlp_delayed > 0) ? (profile_aspm_penalty / profile_aspm_tlp_delayed) * 1e9 : 0,
+           profile_aspm_max_penalty * 1e9, profile_aspm_dllp_delayed);
+}
+
+uint32_t PCIeDataLinkLayer::get_unacked()
+{
+    return DLLTrans_map.size();
+}
+
+uint32_t PCIeDataLinkLayer::get_replay_header_used()
+{
+    return (replayBufferHeader_tail - replayBufferHeader_head + seqNumCount) % seqNumCount;
+}
+
+uint32_t PCIeDataLinkLayer::get_replay_payload_used()
+{
+    return (replayBufferPayload_tail - replayBufferPayload_head + seqNumCount) % seqNumCount;
+}
+
+uint32_t PCIeDataLinkLayer::get_replay_size()
+{
+    return seqNumCount;
+}
+
+void PCIeDataLinkLayer::report_rx_stats()
+{
+    for (size_t vc = 0; vc < rxCredits.size(); vc++) {
+        const auto& channel = rxCredits[vc];
+        SC_LOG(INFO, "rx vc%d: max occupancy P=%d, NP=%d, Cpl=%d DW of %d, UpdateFC: %d", vc, channel[0].profile_max_held, channel[1].profile_max_held, channel[2].profile_max_held, channel[0].capacity.payload, profile_update_fc_count);
+    }
+}
+
 tlm::tlm_sync_enum PCIeDataLinkLayer::nb_transport_fw(tlm::tlm_generic_payload& trans,
                                                      tlm::tlm_phase& phase,
                                                      sc_core::sc_time& delay)
 {
     SC_LOG(VERB, "fw get transaction");
-    m_peq.notify(trans, phase, delay);
+
+    // receive pipeline: LCRC / seqNum check of a TLP in arrival order, fixed handling of a DLLP
+    if (phase == tlm::BEGIN_REQ) {
+        auto tlp_ext = trans.get_extension<PCIeTLPExtension>();
+        delay = rxPipeline.pass(sc_time_stamp() + delay, tlp_ext->tlp.payloads->size()) - sc_time_stamp();
+    }
+    else {
+        delay += rxPipeline.cycles(DLLPProcessCycles);
+    }
+    peq_notify(trans, phase, delay);
     return tlm::TLM_ACCEPTED;
 }
 
+void PCIeDataLinkLayer::peq_notify(tlm::tlm_generic_payload& trans, const tlm::tlm_phase& phase, const sc_core::sc_time& delay)
+{
+    if (peqType == PCIePEQType::Wheel) {
+        m_wheelPeq->notify(trans, phase, delay);
+    }
+    else {
+        m_peq->notify(trans, phase, delay);
+    }
+}
+
+void PCIeDataLinkLayer::deliver_TLP(tlm::tlm_generic_payload& trans)
+{
+    auto tlp_ext = trans.get_extension<PCIeTLPExtension>();
+    std::vector<PCIeTLPPayload> *payloads = tlp_ext->tlp.payloads;
+    sc_time hold_time = SC_ZERO_TIME;
+    if (m_transactionLayer != nullptr) {
+        hold_time = m_transactionLayer->receive_TLP(tlp_ext->tlp.tlp_header, payloads, tlp_ext->vc);
+    }
+
+    // the entry stays in the receive buffer until drained, UpdateFC goes back on the transmitter's VC
+    receive_credits(tlp_ext->vc, get_credit_type(static_cast<PCIeTLPType>(tlp_ext->tlp.tlp_header.Type)), payloads->size(), hold_time);
+}
+
 tlm::tlm_sync_enum PCIeDataLinkLayer::nb_transport_bw(tlm::tlm_generic_payload& trans,
                                                      tlm::tlm_phase& phase,
                                                      sc_core::sc_time& delay)
@@ -364,27 +1418,202 @@ tlm::tlm_sync_enum PCIeDataLinkLayer::nb_transport_bw(tlm::tlm_generic_payload&
 
 void PCIeDataLinkLayer::b_transport(tlm::tlm_generic_payload& trans, sc_core::sc_time& delay) 
 {
-    // TODO: implement
-    (void)trans;
+    // functional delivery, no Ack / UpdateFC, the sender took no credits
     (void)delay;
+    auto tlp_ext = trans.get_extension<PCIeTLPExtension>();
+    if (tlp_ext != nullptr) {
+        PCIE_HOOK(PCIeHook::Receive, tlp_ext->tlp.tlp_header.Type, tlp_ext->vc, tlp_ext->tlp.tlp_header.tag, tlp_ext->tlp.dll_header.seqNum, 1, tlp_ext->tlp.payloads->size());
+    }
+    if (tlp_ext != nullptr && m_transactionLayer != nullptr) {
+        m_transactionLayer->receive_TLP(tlp_ext->tlp.tlp_header, tlp_ext->tlp.payloads, tlp_ext->vc);
+    }
+}
+
+void PCIeDataLinkLayer::set_functional(bool enable)
+{
+    functional = enable;
+    dmiValid = false;
+    SC_LOG(DEBUG, "%s mode", enable ? "fast-forward" : "detailed");
+}
+
+void PCIeDataLinkLayer::transmit_functional(const PCIeTLPHeader& header, uint8_t vc, std::vector<PCIeTLPPayload>* payloads)
+{
+    // fast-forward, no link time, replay buffer or Ack / UpdateFC; the TLP is never in flight,
+    // so the scoreboard has nothing to check
+    std::vector<PCIeTLPPayload> empty;
+    uint32_t seqNum = seqNumPool.front();
+    uint32_t length = (payloads != nullptr) ? payloads->size() : 0;
+
+    tlm::tlm_generic_payload* trans = new tlm::tlm_generic_payload();
+    sc_time delay = SC_ZERO_TIME;
+    auto* tlp_ext = new PCIeTLPExtension();
+    tlp_ext->tlp.dll_header.seqNum = seqNum;
+    tlp_ext->tlp.tlp_header = header;
+    tlp_ext->tlp.payloads = (payloads != nullptr) ? payloads : &empty;
+    tlp_ext->tlp.lcrc = 0x12345678;
+    tlp_ext->vc = vc;
+    tlp_ext->relaxed = header.Attr0 & PCIeAttrRelaxed;
+    tlp_ext->no_snoop = header.Attr0 & PCIeAttrNoSnoop;
+    trans->set_extension(tlp_ext);
+
+    PCIE_HOOK(PCIeHook::Transmit, header.Type, vc, header.tag, seqNum, 1, length);
+    s_out->b_transport(*trans, delay);
+    progress_tlp_sent++;
+    delete trans;
+}
+
+bool PCIeDataLinkLayer::write_direct(uint64_t address, std::vector<PCIeTLPPayload>* payloads)
+{
+    // fast-forward posted write straight into the partner's memory, only when one DMI region holds all of it
+    if (payloads == nullptr || payloads->empty()) {
+        return false;
+    }
+    uint64_t last = address + (payloads->size() * 4) - 1;
+    if (!dmiValid || address < dmi.get_start_address() || last > dmi.get_end_address()) {
+        tlm::tlm_generic_payload trans;
+        trans.set_command(tlm::TLM_WRITE_COMMAND);
+        trans.set_address(address);
+        dmi = tlm::tlm_dmi();
+        dmiValid = s_out->get_direct_mem_ptr(trans, dmi) && dmi.is_write_allowed() && dmi.get_dmi_ptr() != nullptr;
+        if (!dmiValid || address < dmi.get_start_address() || last > dmi.get_end_address()) {
+            return false;
+        }
+    }
+
+    uint32_t* ptr = reinterpret_cast<uint32_t*>(dmi.get_dmi_ptr() + (address - dmi.get_start_address()));
+    for (size_t i = 0; i < payloads->size(); i++) {
+        ptr[i] = payloads->at(i).payload;
+    }
+    progress_tlp_sent++;
+    return true;
+}
+
+void PCIeDataLinkLayer::register_direct_mem_ptr(std::function<bool(uint64_t, tlm::tlm_dmi&)> handler)
+{
+    dmi_handler = handler;
+}
+
+void PCIeDataLinkLayer::register_transport_dbg(std::function<unsigned int(uint64_t, unsigned char*, unsigned int, bool)> handler)
+{
+    dbg_handler = handler;
 }
 
 bool PCIeDataLinkLayer::get_direct_mem_ptr(tlm::tlm_generic_payload& trans, tlm::tlm_dmi& dmi_data) 
 {
-    (void)trans;
-    (void)dmi_data;
-    return false;
+    return dmi_handler && dmi_handler(trans.get_address(), dmi_data);
 }
 
 unsigned int PCIeDataLinkLayer::transport_dbg(tlm::tlm_generic_payload& trans) 
 {
-    (void)trans;
-    return 0;
+    if (!dbg_handler) {
+        return 0;
+    }
+    return dbg_handler(trans.get_address(), trans.get_data_ptr(), trans.get_data_length(), trans.is_write());
+}
+
+void PCIeDataLinkLayer::pause_transmit()
+{
+    txPaused = true;
+}
+
+void PCIeDataLinkLayer::resume_transmit()
+{
+    txPaused = false;
+    event_txResume.notify();
+}
+
+bool PCIeDataLinkLayer::link_is_idle()
+{
+    // nothing on the wire: every sent TLP acked and every DLLP to the partner delivered
+    bool tx_idle = txParked || DLLTrans_queue.empty();
+    return tx_idle && DLLTrans_map.empty() && rxDeliveryPending == 0 && rx_is_drained() && sc_time_stamp() > lastDLLPTime;
+}
+
+void PCIeDataLinkLayer::save(CheckpointWriter& writer)
+{
+    writer.section(name());
+    writer.put_queue(DLLTrans_queue);
+    writer.put_map(DLLTrans_map);
+    writer.put_queue(seqNumPool);
+    writer.put_vector(replayBuffer_header);
+    writer.put_vector(replayBuffer_payload);
+    writer.put(replayBufferHeader_head);
+    writer.put(replayBufferHeader_tail);
+    writer.put(replayBufferPayload_head);
+    writer.put(replayBufferPayload_tail);
+    writer.put_time(aspmTxIdle);
+    writer.put_time(aspmRxLast);
+    writer.put_time(aspmAccounted);
+    writer.put_time(aspmReady);
+}
+
+bool PCIeDataLinkLayer::restore(CheckpointReader& reader)
+{
+    if (!reader.section(name())) {
+        return false;
+    }
+    reader.get_queue(DLLTrans_queue);
+    reader.get_map(DLLTrans_map);
+    reader.get_queue(seqNumPool);
+    if (!reader.get_vector(replayBuffer_header, seqNumCount) || !reader.get_vector(replayBuffer_payload, seqNumCount)) {
+        SC_LOG(ERROR, "checkpoint has a different replay buffer size");
+        return false;
+    }
+    replayBufferHeader_head = reader.get<int32_t>();
+    replayBufferHeader_tail = reader.get<int32_t>();
+    replayBufferPayload_head = reader.get<int32_t>();
+    replayBufferPayload_tail = reader.get<int32_t>();
+    aspmTxIdle = reader.get_time();
+    aspmRxLast = reader.get_time();
+    aspmAccounted = reader.get_time();
+    aspmReady = reader.get_time();
+
+    if (!DLLTrans_queue.empty()) {
+        event_DLLTrans_queue.notify(SC_ZERO_TIME);
+    }
+    return reader.good();
+}
+
+void PCIeDataLinkLayer::set_peq_type(PCIePEQType type)
+{
+    // queues own spawned processes, so one built earlier is kept but left idle
+    peqType = type;
+    if (type == PCIePEQType::Wheel && !m_wheelPeq) {
+        m_wheelPeq.reset(new PCIeWheelPEQ<PCIeDataLinkLayer>(this, &PCIeDataLinkLayer::peq_callback));
+    }
+    else if (type == PCIePEQType::Stock && !m_peq) {
+        m_peq.reset(new tlm_utils::peq_with_cb_and_phase<PCIeDataLinkLayer>(this, &PCIeDataLinkLayer::peq_callback));
+    }
+}
+
+void PCIeDataLinkLayer::set_scoreboard(PCIeScoreboard *scoreboard)
+{
+    m_scoreboard = scoreboard;
 }
 
 void PCIeDataLinkLayer::invalidate_direct_mem_ptr(sc_dt::uint64 start_range, sc_dt::uint64 end_range) 
 {
-    // TODO: implement
-    (void)start_range;
-    (void)end_range;
-}
\ No newline at end of file
+    if (dmiValid && start_range <= dmi.get_end_address() && end_range >= dmi.get_start_address()) {
+        dmiValid = false;
+    }
+}
+
+bool PCIeDataLinkLayer::has_pending_work()
+{
+    // a paused transmitter is draining on purpose
+    return !txPaused && (!DLLTrans_queue.empty() || !DLLTrans_map.empty());
+}
+
+uint64_t PCIeDataLinkLayer::get_progress()
+{
+    return progress_tlp_sent + progress_ack;
+}
+
+void PCIeDataLinkLayer::dump_state()
+{
+    SC_LOG(ERROR, "replay buffer header head=%d, tail=%d, payload head=%d, tail=%d, size=%d", replayBufferHeader_head, replayBufferHeader_tail, replayBufferPayload_head, replayBufferPayload_tail, seqNumCount);
+    SC_LOG(ERROR, "free seqNum: %d/%d, tx queue: %d, unacked: %d, paused: %d, sent: %d, acked: %d", seqNumPool.size(), seqNumCount, DLLTrans_queue.size(), DLLTrans_map.size(), txPaused, progress_tlp_sent, progress_ack);
+    if (!DLLTrans_map.empty()) {
+        SC_LOG(ERROR, "lowest unacked seqNum: %d, header base=%d, payload base=%d", DLLTrans_map.begin()->first, DLLTrans_map.begin()->second.replayBufferHeader_base, DLLTrans_map.begin()->second.replayBufferPayload_base);
+    }
+}
@@ -0,0 +1,115 @@
+#include "pcie_live_stats.hpp"
+#include <csignal>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <new>
+
+// segment of this process for the signal handler, a forked child must not unlink it
+static char live_stats_shm_name[64];
+static pid_t live_stats_owner;
+
+static void live_stats_signal(int sig)
+{
+    if (getpid() == live_stats_owner) {
+        shm_unlink(live_stats_shm_name);
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+//  =================================
+//  PCIeLiveStats Function Definition
+//  =================================
+
+PCIeLiveStats::~PCIeLiveStats()
+{
+    if (shm == nullptr) {
+        return;
+    }
+    publish(true);
+    SC_LOG(INFO, "live stats updates published: %d", profile_publish_count);
+    munmap(shm, sizeof(PCIeLiveStatsShm));
+    shm_unlink(shmName.c_str());
+}
+
+void PCIeLiveStats::open_shm()
+{
+    shmName = LiveStatsShmPrefix + std::to_string(getpid());
+    int fd = shm_open(shmName.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        SC_LOG(WARN, "shm_open %s failed, live stats disabled", shmName.c_str());
+        return;
+    }
+    if (ftruncate(fd, sizeof(PCIeLiveStatsShm)) != 0) {
+        SC_LOG(WARN, "ftruncate %s failed, live stats disabled", shmName.c_str());
+        close(fd);
+        shm_unlink(shmName.c_str());
+        return;
+    }
+    void *addr = mmap(nullptr, sizeof(PCIeLiveStatsShm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        SC_LOG(WARN, "mmap %s failed, live stats disabled", shmName.c_str());
+        shm_unlink(shmName.c_str());
+        return;
+    }
+
+    shm = new (addr) PCIeLiveStatsShm();
+    shm->magic = LiveStatsMagic;
+    shm->version = LiveStatsVersion;
+    shm->pid = getpid();
+    shm->seq.store(0);
+
+    snprintf(live_stats_shm_name, sizeof(live_stats_shm_name), "%s", shmName.c_str());
+    live_stats_owner = getpid();
+    signal(SIGINT, live_stats_signal);
+    signal(SIGTERM, live_stats_signal);
+    SC_LOG(INFO, "live stats at /dev/shm%s", shmName.c_str());
+}
+
+void PCIeLiveStats::process_publish()
+{
+    while (true) {
+        wait(LiveStatsCheckInterval, SC_NS);
+        auto now = std::chrono::steady_clock::now();
+        if (std::chrono::duration_cast<std::chrono::milliseconds>(now - lastPublish).count() >= LiveStatsPeriod) {
+            lastPublish = now;
+            publish(false);
+        }
+    }
+}
+
+void PCIeLiveStats::publish(bool done)
+{
+    if (shm == nullptr) {
+        return;
+    }
+    PCIeTransactionLayer *tl = m_requester->m_transactionLayer;
+    PCIeDataLinkLayer *dll = m_requester->m_dataLinkLayer;
+
+    PCIeLiveStatsData data;
+    std::memset(&data, 0, sizeof(data));
+    data.sim_time = sc_core::sc_time_stamp().to_seconds() * 1e9;
+    data.wall_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    data.throughput = tl->get_throughput();
+    data.progress = tl->get_progress();
+    data.unacked = dll->get_unacked();
+    data.outstanding_np = tl->get_outstanding_NP();
+    for (int type = 0; type < PCIeCreditTypeCount; type++) {
+        PCIeTLPCredit credit = tl->get_credits(0, static_cast<PCIeCreditType>(type));
+        data.credit_header[type] = credit.header;
+        data.credit_payload[type] = credit.payload;
+    }
+    data.replay_header_used = dll->get_replay_header_used();
+    data.replay_payload_used = dll->get_replay_payload_used();
+    data.replay_size = dll->get_replay_size();
+    data.internal_used = tl->get_internal_buffer_used();
+    data.internal_size = tl->get_internal_buffer_size();
+    data.done = done;
+    shm->publish(data);
+
+    // profiling
+    profile_publish_count++;
+}
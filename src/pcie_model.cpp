@@ -0,0 +1,465 @@
+#include "pcie_model.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+//  =====================================
+//  PCIeAnalyticModel Function Definition
+//  =====================================
+
+static const char* model_resource_name[] = {"requester", "TL pipeline", "DLL pipeline", "link", "rx drain", "internal buffer", "credit header", "credit payload", "tag", "replay header", "replay payload"};
+
+// queue positions along the path: TL queue, replay buffer insert, link, receive drain
+enum { ModelWaitTL, ModelWaitInsert, ModelWaitLink, ModelWaitDrain, ModelWaitCount };
+
+const char* pcie_model_resource_name(PCIeModelResource resource)
+{
+    return model_resource_name[static_cast<int>(resource)];
+}
+
+PCIeAnalyticModel::PCIeAnalyticModel(const PCIeModelWorkload& workload_)
+: workload(workload_)
+{
+    combine_lengths();
+
+    // profiling
+    profile_predict_count = 0;
+}
+
+// stationary TLP length distribution of the write combiner, Markov chain over {buffered DW, buffered writes}
+//   a discontiguous write or one that overflows MPS flushes the open buffer and opens a new one,
+//   the buffer also leaves once full or after combineWrites writes (timeout)
+void PCIeAnalyticModel::combine_lengths()
+{
+    uint32_t mps = PCIeMaxPayloadSize / 4;
+    uint32_t limit = std::max(mps, workload.maxDW);
+    uint32_t writes = std::max<uint32_t>(workload.combineWrites, 1);
+    double p = workload.sequential;
+    double n = workload.maxDW - workload.minDW + 1;
+    auto index = [writes](uint32_t a, uint32_t k) { return (a * (writes + 1)) + k; };
+
+    std::vector<double> state((limit + 1) * (writes + 1), 0.0);
+    std::vector<double> next(state.size());
+    std::vector<double> emit(limit + 1);
+    state[index(0, 0)] = 1.0;
+
+    for (int pass = 0; pass < ModelCombinePass; pass++) {
+        std::fill(next.begin(), next.end(), 0.0);
+        std::fill(emit.begin(), emit.end(), 0.0);
+        auto place = [&](uint32_t a, uint32_t k, double weight) {
+            if (a >= mps || k >= writes) {
+                emit[a] += weight;
+                next[index(0, 0)] += weight;
+            }
+            else {
+                next[index(a, k)] += weight;
+            }
+        };
+
+        for (uint32_t a = 0; a <= limit; a++) {
+            for (uint32_t k = 0; k <= writes; k++) {
+                double mass = state[index(a, k)];
+                if (mass == 0) {
+                    continue;
+                }
+                for (uint32_t l = workload.minDW; l <= workload.maxDW; l++) {
+                    double q = mass / n;
+                    if (a == 0) {
+                        place(l, 1, q);
+                        continue;
+                    }
+                    double flush = ((a + l) > mps) ? q : (q * (1 - p));
+                    emit[a] += flush;
+                    place(l, 1, flush);
+                    if (q > flush) {
+                        place(a + l, k + 1, q - flush);
+                    }
+                }
+            }
+        }
+        state.swap(next);
+    }
+
+    // emit holds TLPs per write of the last pass
+    double rate = 0;
+    for (double weight : emit) {
+        rate += weight;
+    }
+    lengthPMF.assign(emit.size(), 0.0);
+    for (size_t l = 0; l < emit.size(); l++) {
+        lengthPMF[l] = emit[l] / rate;
+    }
+    writesPerTLP = 1 / rate;
+}
+
+double PCIeAnalyticModel::expect_beats(uint32_t width, uint32_t power)
+{
+    double sum = 0;
+    for (size_t l = 0; l < lengthPMF.size(); l++) {
+        double beats = std::max<size_t>((l + width - 1) / width, 1);
+        sum += lengthPMF[l] * std::pow(beats, power);
+    }
+    return sum;
+}
+
+uint32_t PCIeAnalyticModel::percentile_beats(uint32_t width, double fraction)
+{
+    double seen = 0;
+    for (size_t l = 0; l < lengthPMF.size(); l++) {
+        seen += lengthPMF[l];
+        if (seen >= fraction) {
+            return std::max<size_t>((l + width - 1) / width, 1);
+        }
+    }
+    return std::max<size_t>((lengthPMF.size() + width - 2) / width, 1);
+}
+
+// TLPs freed per UpdateFC, renewal count until the payload or header threshold is reached,
+// reach[k] is the chance the batch holds more than k TLPs
+double PCIeAnalyticModel::update_fc_batch(std::vector<double>& reach)
+{
+    std::vector<double> below(UpdateFCPayloadThreshold, 0.0);
+    below[0] = 1.0;
+    reach.assign(UpdateFCHeaderThreshold, 0.0);
+    double batch = 0;
+    for (int k = 0; k < UpdateFCHeaderThreshold; k++) {
+        double mass = 0;
+        for (double weight : below) {
+            mass += weight;
+        }
+        reach[k] = mass;
+        batch += mass;
+
+        std::vector<double> next(below.size(), 0.0);
+        for (size_t sum = 0; sum < below.size(); sum++) {
+            for (size_t l = 1; (sum + l) < below.size() && l < lengthPMF.size(); l++) {
+                next[sum + l] += below[sum] * lengthPMF[l];
+            }
+        }
+        below.swap(next);
+    }
+    return batch;
+}
+
+// ns of backend capacity per TLP: MemoryQueueDepth requests in flight, each held from accept to done,
+// DRAM taken at a row conflict, data on the bus serialized per channel
+double PCIeAnalyticModel::backend_demand()
+{
+    double hold = 0;
+    double bus = 0;
+    for (size_t l = 0; l < lengthPMF.size(); l++) {
+        double byte = l * 4.0;
+        if (CompleterMemoryBackend == MemoryBackendDRAM) {
+            double bursts = ((std::max(byte, 4.0) - 4) / DRAMBurstSize) + 1;
+            hold += lengthPMF[l] * (DRAMtRP + DRAMtRCD + DRAMtCL + (bursts * DRAMtBurst));
+            bus += lengthPMF[l] * (bursts * DRAMtBurst) / DRAMChannels;
+        }
+        else {
+            hold += lengthPMF[l] * (MemoryFixedLatency + (byte / MemoryFixedBandwidth));
+            bus += lengthPMF[l] * (byte / MemoryFixedBandwidth);
+        }
+    }
+    return std::max(bus, hold / MemoryQueueDepth);
+}
+
+// send latency of TLPs let in by one credit return, issued every interval ns into the TL pipeline,
+// Lindley recursion over the burst position on the TL clock
+void PCIeAnalyticModel::burst_latency(double interval, const std::vector<double>& reach, double& mean, double& p99)
+{
+    double tl_cycle = 1000.0 / TLClockMHz;
+    std::vector<double> service;
+    for (size_t l = 0; l < lengthPMF.size(); l++) {
+        size_t beats = std::max<size_t>((l + TLDatapathDW - 1) / TLDatapathDW, 1);
+        if (service.size() <= beats) {
+            service.resize(beats + 1, 0.0);
+        }
+        service[beats] += lengthPMF[l];
+    }
+    long gap = std::lround(interval / tl_cycle);
+
+    double total = 0;
+    for (double weight : reach) {
+        total += weight;
+    }
+    std::vector<double> wait = {1.0};
+    std::vector<double> latency;
+    mean = 0;
+    for (double weight : reach) {
+        std::vector<double> next(wait.size() + service.size(), 0.0);
+        for (size_t w = 0; w < wait.size(); w++) {
+            for (size_t b = 0; b < service.size(); b++) {
+                double mass = wait[w] * service[b];
+                if (mass == 0) {
+                    continue;
+                }
+                if (latency.size() <= w + b) {
+                    latency.resize(w + b + 1, 0.0);
+                }
+                latency[w + b] += mass * (weight / total);
+                mean += mass * (weight / total) * (w + b) * tl_cycle;
+                next[std::max<long>(0, static_cast<long>(w + b) - gap)] += mass;
+            }
+        }
+        wait.swap(next);
+    }
+
+    double seen = 0;
+    p99 = 0;
+    for (size_t cycles = 0; cycles < latency.size(); cycles++) {
+        seen += latency[cycles];
+        if (seen >= 0.99) {
+            p99 = cycles * tl_cycle;
+            break;
+        }
+    }
+}
+
+// exact MVA, one queueing station plus a delay, linear between whole populations
+double PCIeAnalyticModel::mva(double population, double service, double delay)
+{
+    if (population <= 0) {
+        return 0;
+    }
+    if (service <= 0) {
+        return (delay > 0) ? population / delay : std::numeric_limits<double>::infinity();
+    }
+
+    double queue = 0;
+    double throughput = 0;
+    uint32_t whole = static_cast<uint32_t>(population);
+    for (uint32_t i = 1; i <= whole; i++) {
+        double residence = service * (1 + queue);
+        throughput = i / (residence + delay);
+        queue = throughput * residence;
+        if ((1 / service) - throughput < 1e-9 / service) {
+            return throughput;
+        }
+    }
+    double fraction = population - whole;
+    double residence = service * (1 + queue);
+    return throughput + (fraction * (((whole + 1) / (residence + delay)) - throughput));
+}
+
+PCIeModelResult PCIeAnalyticModel::predict(const PCIeResourceConfig& config)
+{
+    const double infinity = std::numeric_limits<double>::infinity();
+    const int count = static_cast<int>(PCIeModelResource::Count);
+    double tl_cycle = 1000.0 / TLClockMHz;
+    double dll_cycle = 1000.0 / DLLClockMHz;
+
+    // TLP length and per-TLP service of each station, ns
+    double length = 0;
+    double link = 0;
+    double link_square = 0;
+    uint32_t longest = 0;
+    for (size_t l = 0; l < lengthPMF.size(); l++) {
+        if (lengthPMF[l] == 0) {
+            continue;
+        }
+        double dll_beats = std::max<size_t>((l + DLLDatapathDW - 1) / DLLDatapathDW, 1);
+        double wire = std::max(static_cast<double>(l * LinkNsPerDW), (DLLTxStages > 0) ? dll_beats * dll_cycle : 0.0);
+        length += lengthPMF[l] * l;
+        link += lengthPMF[l] * wire;
+        link_square += lengthPMF[l] * wire * wire;
+        longest = l;
+    }
+
+    std::array<double, count> demand;
+    demand.fill(0);
+    demand[static_cast<int>(PCIeModelResource::Requester)] = writesPerTLP * workload.issueInterval;
+    demand[static_cast<int>(PCIeModelResource::TLPipeline)] = (TLTxStages > 0) ? expect_beats(TLDatapathDW, 1) * tl_cycle : 0;
+    demand[static_cast<int>(PCIeModelResource::DLLPipeline)] = (DLLTxStages > 0) ? expect_beats(DLLDatapathDW, 1) * dll_cycle : 0;
+    demand[static_cast<int>(PCIeModelResource::Link)] = link;
+    demand[static_cast<int>(PCIeModelResource::RxDrain)] = (RxDrainMode == RxDrainFixed) ? RxDrainHeaderNs + (length / RxDrainDWPerNs) : backend_demand();
+
+    // fixed delays: pipeline fills and TLP flight ride on the wire, receive pipelines, DLLP flight and processing
+    double tl = demand[static_cast<int>(PCIeModelResource::TLPipeline)];
+    double drain = demand[static_cast<int>(PCIeModelResource::RxDrain)];
+    double fill = ((TLTxStages > 0) ? (TLTxStages - 1) * tl_cycle : 0) + ((DLLTxStages > 0) ? (DLLTxStages - 1) * dll_cycle : 0) + LinkFlightTime;
+    double rx_dll = (DLLRxStages > 0) ? (expect_beats(DLLDatapathDW, 1) + DLLRxStages - 1) * dll_cycle : 0;
+    double rx_tl = (TLRxStages > 0) ? (expect_beats(TLDatapathDW, 1) + TLRxStages - 1) * tl_cycle : 0;
+    double dllp = DLLPFlightTime + ((DLLRxStages > 0) ? DLLPProcessCycles * dll_cycle : 0);
+    std::vector<double> reach;
+    double batch = update_fc_batch(reach);
+
+    // window population in TLPs, ring buffers keep one entry free,
+    // a window that cannot hold the longest TLP never lets it go
+    double vcs = TLVCCount;
+    std::array<double, count> population;
+    population.fill(infinity);
+    population[static_cast<int>(PCIeModelResource::InternalBuffer)] = ((config.internalBufferSize / vcs) - 1 >= longest) ? ((config.internalBufferSize / vcs) - 1) / length : 0;
+    double credits = std::floor(config.credits / (vcs * PCIeCreditTypeCount));
+    population[static_cast<int>(PCIeModelResource::CreditHeader)] = credits;
+    population[static_cast<int>(PCIeModelResource::CreditPayload)] = (credits >= longest) ? credits / length : 0;
+    population[static_cast<int>(PCIeModelResource::Tag)] = config.tagCount;
+    population[static_cast<int>(PCIeModelResource::ReplayHeader)] = config.replayBufferSize - 1.0;
+    population[static_cast<int>(PCIeModelResource::ReplayPayload)] = ((config.replayBufferSize - 1) >= longest) ? (config.replayBufferSize - 1.0) / length : 0;
+
+    // residence without waiting and the bottleneck station inside each window
+    std::array<double, count> residence;
+    std::array<double, count> service;
+    std::array<PCIeModelResource, count> station;
+    residence.fill(0);
+    for (int r = 0; r < count; r++) {
+        station[r] = static_cast<PCIeModelResource>(r);
+    }
+    auto window_station = [&demand](std::initializer_list<PCIeModelResource> stations) {
+        PCIeModelResource slowest = *stations.begin();
+        for (PCIeModelResource candidate : stations) {
+            if (demand[static_cast<int>(candidate)] > demand[static_cast<int>(slowest)]) {
+                slowest = candidate;
+            }
+        }
+        return slowest;
+    };
+    PCIeModelResource replay_station = window_station({PCIeModelResource::Link, PCIeModelResource::DLLPipeline});
+    PCIeModelResource tag_station = window_station({PCIeModelResource::Link, PCIeModelResource::DLLPipeline, PCIeModelResource::TLPipeline});
+    PCIeModelResource credit_station = window_station({PCIeModelResource::Link, PCIeModelResource::DLLPipeline, PCIeModelResource::TLPipeline, PCIeModelResource::RxDrain});
+    station[static_cast<int>(PCIeModelResource::ReplayHeader)] = replay_station;
+    station[static_cast<int>(PCIeModelResource::ReplayPayload)] = replay_station;
+    station[static_cast<int>(PCIeModelResource::Tag)] = tag_station;
+    station[static_cast<int>(PCIeModelResource::InternalBuffer)] = credit_station;
+    station[static_cast<int>(PCIeModelResource::CreditHeader)] = credit_station;
+    station[static_cast<int>(PCIeModelResource::CreditPayload)] = credit_station;
+    for (int r = 0; r < count; r++) {
+        service[r] = demand[static_cast<int>(station[r])];
+    }
+
+    // UpdateFC coalescing waits on the throughput it throttles, iterate to a fixed point
+    std::array<double, count> bound;
+    double throughput = 0;
+    double station_limit = 0;
+    for (int r = 0; r <= static_cast<int>(PCIeModelResource::RxDrain); r++) {
+        station_limit = std::max(station_limit, demand[r]);
+    }
+    double x = (station_limit > 0) ? 1 / station_limit : 1;
+    for (int pass = 0; pass < ModelFixedPointPass; pass++) {
+        double coalesce = (batch > 1 && x > 0) ? std::min<double>(UpdateFCTimer, (batch - 1) / (2 * x)) : 0;
+        double replay = link + fill + rx_dll + dllp;
+        double credit = tl + link + fill + rx_dll + rx_tl + drain + coalesce + dllp;
+        residence[static_cast<int>(PCIeModelResource::ReplayHeader)] = replay;
+        residence[static_cast<int>(PCIeModelResource::ReplayPayload)] = replay;
+        residence[static_cast<int>(PCIeModelResource::Tag)] = tl + replay;
+        residence[static_cast<int>(PCIeModelResource::InternalBuffer)] = credit;
+        residence[static_cast<int>(PCIeModelResource::CreditHeader)] = credit;
+        residence[static_cast<int>(PCIeModelResource::CreditPayload)] = credit;
+
+        for (int r = 0; r < count; r++) {
+            if (r <= static_cast<int>(PCIeModelResource::RxDrain)) {
+                bound[r] = (demand[r] > 0) ? 1 / demand[r] : infinity;
+            }
+            else {
+                bound[r] = std::isinf(population[r]) ? infinity : mva(population[r], service[r], residence[r] - service[r]);
+            }
+        }
+        throughput = *std::min_element(bound.begin(), bound.end());
+        if (std::fabs(throughput - x) <= 1e-12 * x) {
+            break;
+        }
+        x = (x + throughput) / 2;
+    }
+    x = throughput;
+
+    // a window whose MVA throughput reached its station's rate is not what limits
+    auto stations_end = bound.begin() + static_cast<int>(PCIeModelResource::RxDrain) + 1;
+    PCIeModelResource binding = static_cast<PCIeModelResource>(std::min_element(bound.begin(), stations_end) - bound.begin());
+    for (int r = static_cast<int>(PCIeModelResource::InternalBuffer); r < count; r++) {
+        if (bound[r] < bound[static_cast<int>(binding)] * (1 - ModelBindingMargin) && bound[r] <= x) {
+            binding = static_cast<PCIeModelResource>(r);
+        }
+    }
+
+    PCIeModelResult result;
+    result.throughput = x * length * 4;
+    result.tlp_length = length;
+    result.binding = binding;
+    for (int r = 0; r < count; r++) {
+        result.bound[r] = bound[r] * length * 4;
+    }
+
+    // saturated source: the backlog sits in front of the bottleneck station and spills outward,
+    // each queue position takes what the tightest window enclosing it still has room for
+    std::array<double, ModelWaitCount> wait;
+    wait.fill(0);
+    double tl_wait = 0;
+    double tl_wait_p99 = 0;
+    double tl_p99 = (TLTxStages > 0) ? percentile_beats(TLDatapathDW, 0.99) * tl_cycle : 0;
+    double tail = 0;
+    if (binding != PCIeModelResource::Requester && x > 0) {
+        static const uint8_t covers[] = {
+            0, 0, 0, 0, 0,
+            0xF,    // internal buffer: TL queue .. drain
+            0xE,    // credit header: insert .. drain
+            0xE,    // credit payload
+            0x6,    // tag: insert, link
+            0x4,    // replay header: link
+            0x4,    // replay payload
+        };
+        PCIeModelResource slowest = station[static_cast<int>(binding)];
+        int bottleneck = (slowest == PCIeModelResource::TLPipeline) ? ModelWaitTL : ((slowest == PCIeModelResource::RxDrain) ? ModelWaitDrain : ModelWaitLink);
+
+        for (int position = bottleneck; position >= 0; position--) {
+            double room = infinity;
+            for (int r = static_cast<int>(PCIeModelResource::InternalBuffer); r < count; r++) {
+                if (!(covers[r] & (1 << position)) || std::isinf(population[r])) {
+                    continue;
+                }
+                double left = (population[r] / x) - residence[r];
+                for (int inner = position + 1; inner < ModelWaitCount; inner++) {
+                    if (covers[r] & (1 << inner)) {
+                        left -= wait[inner];
+                    }
+                }
+                room = std::min(room, left);
+            }
+            wait[position] = std::isinf(room) ? 0 : std::max(0.0, room);
+        }
+
+        // TLPs ahead of one at the TL / insert queues, each one bottleneck service
+        double ahead = (wait[ModelWaitTL] + wait[ModelWaitInsert]) * x;
+        tail = ModelTailQuantile * std::sqrt(ahead * std::max(0.0, link_square - (link * link)));
+
+        // the blocked source refills the TL one credit return at a time
+        if (tl > 0) {
+            double burst_mean;
+            burst_latency(demand[static_cast<int>(PCIeModelResource::Requester)], reach, burst_mean, tl_p99);
+            tl_wait = burst_mean - tl;
+        }
+    }
+    else if (tl > 0) {
+        // open arrivals, M/G/1 at the TL pipeline, exponential tail for the percentile
+        double rho = x * tl;
+        double second = expect_beats(TLDatapathDW, 2) * tl_cycle * tl_cycle;
+        tl_wait = (rho < 1) ? (x * second) / (2 * (1 - rho)) : 0;
+        tl_wait_p99 = (rho > 0.01) ? (tl_wait / rho) * std::log(100 * rho) : 0;
+    }
+
+    double waiting = wait[ModelWaitTL] + wait[ModelWaitInsert];
+    result.mean_latency = tl + tl_wait + waiting;
+    result.p99_latency = tl_p99 + std::max(0.0, tl_wait_p99) + waiting + tail;
+
+    // profiling
+    profile_predict_count++;
+    return result;
+}
+
+void PCIeAnalyticModel::report(const PCIeModelResult& result)
+{
+    SC_LOG(INFO, "predicted: %.2f GB/s, latency mean %.2f ns, p99 %.2f ns, TLP %.2f DW, %.2f writes/TLP, binding: %s", result.throughput, result.mean_latency, result.p99_latency, result.tlp_length, writesPerTLP, pcie_model_resource_name(result.binding));
+    for (int r = 0; r < static_cast<int>(PCIeModelResource::Count); r++) {
+        if (!std::isinf(result.bound[r])) {
+            SC_LOG(INFO, "  %-16s bound %8.2f GB/s", model_resource_name[r], result.bound[r]);
+        }
+    }
+}
+
+void PCIeAnalyticModel::report_divergence(const PCIeModelResult& result, const PCIeSizingResult& simulated)
+{
+    auto divergence = [](double model, double sim) { return (sim != 0) ? ((model - sim) / sim) * 100 : 0; };
+    SC_LOG(INFO, "throughput:   model %8.2f GB/s, simulated %8.2f GB/s, divergence %+7.2f%%", result.throughput, simulated.throughput, divergence(result.throughput, simulated.throughput));
+    SC_LOG(INFO, "mean latency: model %8.2f ns,   simulated %8.2f ns,   divergence %+7.2f%%", result.mean_latency, simulated.mean_latency, divergence(result.mean_latency, simulated.mean_latency));
+
+    // the simulated p99 is the upper edge of its TLLatencyHistBucket histogram bucket
+    double p99 = (std::floor(result.p99_latency / TLLatencyHistBucket) + 1) * TLLatencyHistBucket;
+    SC_LOG(INFO, "p99 latency:  model %8.2f ns,   simulated %8.2f ns,   divergence %+7.2f%% (model %.2f ns before bucketing)", p99, simulated.p99_latency, divergence(p99, simulated.p99_latency), result.p99_latency);
+}
@@ -0,0 +1,336 @@
+#include "pcie_partition.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+PCIePartitionShared* create_partition_shared(const PCIePartitionTopology& topology)
+{
+    if (topology.linkCount == 0 || topology.partitionCount == 0 || topology.partitionCount > PartitionMaxCount || topology.linkCount > PartitionMaxLinks) {
+        return nullptr;
+    }
+
+    size_t size = sizeof(PCIePartitionShared) + (2 * topology.linkCount * sizeof(PCIeLinkChannel)) + (topology.linkCount * sizeof(PCIeLinkBarrier));
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return nullptr;
+    }
+
+    PCIePartitionShared *shared = new (memory) PCIePartitionShared();
+    shared->topology = topology;
+    for (uint32_t link = 0; link < topology.linkCount; link++) {
+        for (uint32_t side = 0; side < 2; side++) {
+            PCIeLinkChannel& channel = shared->channel(link, side);
+            channel.messages.head.store(0);
+            channel.messages.tail.store(0);
+            channel.messages.sealed[0] = 0;
+            channel.messages.sealed[1] = 0;
+            channel.payloads.head.store(0);
+            channel.payloads.tail = 0;
+        }
+        PCIeLinkBarrier& barrier = shared->barrier(link);
+        barrier.arrived.store(0);
+        barrier.generation.store(0);
+    }
+    return shared;
+}
+
+int fork_partitions(PCIePartitionShared *shared)
+{
+    shared->pid[0] = getpid();
+    for (uint32_t id = 1; id < shared->topology.partitionCount; id++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+            shared->pid[id] = getpid();
+            return id;
+        }
+        shared->pid[id] = pid;
+    }
+    return 0;
+}
+
+void join_partitions(PCIePartitionShared *shared)
+{
+    for (uint32_t id = 1; id < shared->topology.partitionCount; id++) {
+        waitpid(shared->pid[id], nullptr, 0);
+    }
+}
+
+//  =================================
+//  PCIePartition Function Definition
+//  =================================
+
+void PCIePartition::add_proxy(PCIeLinkProxy *proxy)
+{
+    auto it = proxies.begin();
+    while (it != proxies.end() && (*it)->get_link() < proxy->get_link()) {
+        it++;
+    }
+    proxies.insert(it, proxy);
+}
+
+void PCIePartition::process_sync()
+{
+    // same run time and window in every partition, so all of them leave after the same last exchange
+    sc_core::sc_time window = sc_core::sc_time(PartitionLookahead * PartitionSyncFactor, SC_NS);
+    uint64_t last_round = static_cast<uint64_t>(std::ceil(runTime / window));
+    if (proxies.empty()) {
+        wait(window * static_cast<double>(last_round));
+        sc_core::sc_stop();
+        return;
+    }
+
+    while (round < last_round) {
+        wait(window);
+
+        // every link seals before any barrier, a peer waiting on another link never sees a moving tail
+        for (PCIeLinkProxy *proxy : proxies) {
+            proxy->seal(round);
+        }
+        for (PCIeLinkProxy *proxy : proxies) {
+            proxy->exchange();
+        }
+        round++;
+        profile_sync_count++;
+    }
+    sc_core::sc_stop();
+}
+
+void PCIePartition::report_stats()
+{
+    SC_LOG(INFO, "partition %d: link: %zu, sync: %llu", id, proxies.size(), static_cast<unsigned long long>(profile_sync_count));
+    for (PCIeLinkProxy *proxy : proxies) {
+        proxy->report_stats();
+    }
+}
+
+//  =================================
+//  PCIeLinkProxy Function Definition
+//  =================================
+
+bool PCIeLinkProxy::peer_is_gone()
+{
+    // the first partition reaps every child, a child follows the first partition out by PDEATHSIG
+    if (id != 0) {
+        return getppid() != shared->pid[0];
+    }
+    for (uint32_t partition = 1; partition < shared->topology.partitionCount; partition++) {
+        if (waitpid(shared->pid[partition], nullptr, WNOHANG) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PCIeLinkProxy::barrier()
+{
+    // the later end to arrive opens the next round of this link
+    PCIeLinkBarrier& sync = shared->barrier(link);
+    uint32_t generation = sync.generation.load(std::memory_order_acquire);
+    if (sync.arrived.fetch_add(1, std::memory_order_acq_rel) == 1) {
+        sync.arrived.store(0, std::memory_order_relaxed);
+        sync.generation.store(generation + 1, std::memory_order_release);
+        return;
+    }
+
+    uint32_t spin = 0;
+    while (sync.generation.load(std::memory_order_acquire) == generation) {
+        if ((++spin % PartitionPeerPoll) == 0) {
+            if (peer_is_gone()) {
+                SC_LOG(ERROR, "peer partition exited");
+                _exit(1);
+            }
+            std::this_thread::yield();
+        }
+    }
+}
+
+void PCIeLinkProxy::seal(uint64_t round_)
+{
+    round = round_;
+    PCIeLinkChannel& tx = shared->channel(link, side);
+    tx.messages.sealed[round % 2] = tx.messages.tail.load(std::memory_order_relaxed);
+}
+
+void PCIeLinkProxy::exchange()
+{
+    // only messages sent before the peer reached the barrier are taken, keeps runs deterministic
+    PCIeLinkChannel& rx = shared->channel(link, side ^ 1);
+    barrier();
+    uint64_t limit = rx.messages.sealed[round % 2];
+    for (PCIeLinkMessage *message = rx.messages.front(limit); message != nullptr; message = rx.messages.front(limit)) {
+        deliver(*message, rx.payloads);
+        rx.payloads.release(message->offset + message->length);
+        rx.messages.pop();
+    }
+}
+
+void PCIeLinkProxy::send(tlm::tlm_generic_payload& trans, const tlm::tlm_phase& phase, const sc_core::sc_time& delay, bool functional)
+{
+    PCIeLinkChannel& tx = shared->channel(link, side);
+    sc_core::sc_time lookahead = sc_core::sc_time(PartitionLookahead, SC_NS);
+    if (!functional && delay < lookahead) {
+        SC_LOG(ERROR, "message delay below the link flight time, lookahead does not hold");
+        std::abort();
+    }
+
+    // the peer frees slots and payload while it takes the last window's messages, a window that fills the ring alone never drains
+    uint32_t length = 0;
+    auto tlp_ext = (phase == tlm::BEGIN_REQ) ? trans.get_extension<PCIeTLPExtension>() : nullptr;
+    if (tlp_ext != nullptr && tlp_ext->tlp.payloads != nullptr) {
+        length = tlp_ext->tlp.payloads->size();
+    }
+    assert(length <= PartitionMaxPayloadDW);
+    uint64_t offset = 0;
+    PCIeLinkMessage *message = tx.payloads.reserve(length, offset) ? tx.messages.reserve() : nullptr;
+    uint32_t spin = 0;
+    while (message == nullptr && tx.messages.head.load(std::memory_order_acquire) < tx.messages.sealed[round % 2]) {
+        if ((++spin % PartitionPeerPoll) == 0) {
+            if (peer_is_gone()) {
+                SC_LOG(ERROR, "peer partition exited");
+                _exit(1);
+            }
+            std::this_thread::yield();
+        }
+        message = tx.payloads.reserve(length, offset) ? tx.messages.reserve() : nullptr;
+    }
+    if (message == nullptr) {
+        SC_LOG(ERROR, "link channel full within one window, raise PartitionChannelSlots or PartitionPayloadDW");
+        std::abort();
+    }
+
+    // fast-forward keeps no link timing, it goes with the next window
+    sc_core::sc_time arrival = sc_core::sc_time_stamp() + (functional ? lookahead : delay);
+    message->time = static_cast<uint64_t>((arrival.to_seconds() * 1e12) + 0.5);
+    message->phase = (phase == tlm::BEGIN_REQ) ? 0 : 1;
+    message->functional = functional;
+
+    message->length = length;
+    message->offset = offset;
+    if (phase == tlm::BEGIN_REQ) {
+        message->header = tlp_ext->tlp.tlp_header;
+        message->seqNum = tlp_ext->tlp.dll_header.seqNum;
+        message->relaxed = tlp_ext->relaxed;
+        message->no_snoop = tlp_ext->no_snoop;
+        message->vc = tlp_ext->vc;
+        for (uint32_t i = 0; i < length; i++) {
+            tx.payloads.data[(offset + i) % PartitionPayloadDW] = tlp_ext->tlp.payloads->at(i);
+        }
+    }
+    else {
+        auto dllp_ext = trans.get_extension<PCIeDLLPExtension>();
+        message->seqNum = dllp_ext->seqNum;
+        message->dllp_type = dllp_ext->dllp_type;
+        message->fc_type = dllp_ext->fc_type;
+        message->fc = dllp_ext->fc;
+        message->fc_header = dllp_ext->fc_header;
+        message->vc = dllp_ext->dllp.header.VC;
+    }
+
+    // the message commit publishes its payload too
+    tx.payloads.commit(length);
+    tx.messages.commit();
+    profile_tx_count++;
+}
+
+void PCIeLinkProxy::deliver(const PCIeLinkMessage& message, const PCIeSPSCDataRing<PartitionPayloadDW>& payloads)
+{
+    tlm::tlm_generic_payload* trans = new tlm::tlm_generic_payload();
+    tlm::tlm_phase phase = (message.phase == 0) ? tlm::BEGIN_REQ : tlm::BEGIN_RESP;
+
+    // due after the window end it keeps its time, due inside the window it was sent in it is late
+    sc_core::sc_time arrival = sc_core::sc_time(static_cast<double>(message.time), SC_PS);
+    sc_core::sc_time delay = SC_ZERO_TIME;
+    if (arrival >= sc_core::sc_time_stamp()) {
+        delay = arrival - sc_core::sc_time_stamp();
+    }
+    else if (!message.functional) {
+        profile_late_count++;
+        profile_max_late = std::max(profile_max_late, (sc_core::sc_time_stamp() - arrival).to_seconds());
+    }
+
+    if (phase == tlm::BEGIN_REQ) {
+        auto* tlp_ext = new PCIeTLPExtension();
+        tlp_ext->tlp.tlp_header = message.header;
+        tlp_ext->tlp.dll_header.seqNum = message.seqNum;
+        tlp_ext->tlp.payloads = new std::vector<PCIeTLPPayload>(message.length);
+        for (uint32_t i = 0; i < message.length; i++) {
+            tlp_ext->tlp.payloads->at(i) = payloads.data[(message.offset + i) % PartitionPayloadDW];
+        }
+        tlp_ext->tlp.lcrc = 0x12345678;
+        tlp_ext->relaxed = message.relaxed;
+        tlp_ext->no_snoop = message.no_snoop;
+        tlp_ext->vc = message.vc;
+        trans->set_extension(tlp_ext);
+    }
+    else {
+        auto* dllp_ext = new PCIeDLLPExtension();
+        dllp_ext->seqNum = message.seqNum;
+        dllp_ext->dllp_type = message.dllp_type;
+        dllp_ext->fc_type = message.fc_type;
+        dllp_ext->fc = message.fc;
+        dllp_ext->fc_header = message.fc_header;
+        dllp_ext->dllp.header.VC = message.vc;
+        trans->set_extension(dllp_ext);
+    }
+
+    if (message.functional) {
+        s_out->b_transport(*trans, delay);
+    }
+    else {
+        s_out->nb_transport_fw(*trans, phase, delay);
+    }
+    profile_rx_count++;
+}
+
+tlm::tlm_sync_enum PCIeLinkProxy::nb_transport_fw(tlm::tlm_generic_payload& trans, tlm::tlm_phase& phase, sc_core::sc_time& delay)
+{
+    send(trans, phase, delay, false);
+    return tlm::TLM_ACCEPTED;
+}
+
+tlm::tlm_sync_enum PCIeLinkProxy::nb_transport_bw(tlm::tlm_generic_payload& trans, tlm::tlm_phase& phase, sc_core::sc_time& delay)
+{
+    (void)trans;
+    (void)phase;
+    (void)delay;
+    return tlm::TLM_ACCEPTED;
+}
+
+void PCIeLinkProxy::b_transport(tlm::tlm_generic_payload& trans, sc_core::sc_time& delay)
+{
+    // fast-forward has the sender settle its own credits, only the payload crosses
+    send(trans, tlm::BEGIN_REQ, delay, true);
+}
+
+bool PCIeLinkProxy::get_direct_mem_ptr(tlm::tlm_generic_payload& trans, tlm::tlm_dmi& dmi_data)
+{
+    (void)trans;
+    (void)dmi_data;
+    return false;
+}
+
+unsigned int PCIeLinkProxy::transport_dbg(tlm::tlm_generic_payload& trans)
+{
+    (void)trans;
+    return 0;
+}
+
+void PCIeLinkProxy::invalidate_direct_mem_ptr(sc_dt::uint64 start_range, sc_dt::uint64 end_range)
+{
+    (void)start_range;
+    (void)end_range;
+}
+
+void PCIeLinkProxy::report_stats()
+{
+    SC_LOG(INFO, "link %u: sent: %llu, received: %llu, late: %llu, max late: %.2f ns", link, static_cast<unsigned long long>(profile_tx_count), static_cast<unsigned long long>(profile_rx_count), static_cast<unsigned long long>(profile_late_count), profile_max_late * 1e9);
+}
@@ -6,41 +6,160 @@
 
 void PCIeRequester_::process_send_command()
 {
-    int i = 0;
-    sc_core::sc_time start_time = sc_core::sc_time_stamp();
+    start_time = sc_core::sc_time_stamp();
 
     while (true) {
-        wait(5, sc_core::SC_NS);
-
-        std::vector<PCIeTLPPayload> *payloads = new std::vector<PCIeTLPPayload>();
-        uint32_t length = rand.nextInt();
-        for (uint32_t dw = 0; dw < length; dw++) {
-            PCIeTLPPayload payload;
-            payload.payload = i;
-            payloads->emplace_back(payload);
+        wait(RequesterIssueInterval, sc_core::SC_NS);
+        while (generatorPaused) {
+            generatorParked = true;
+            wait(event_generatorResume);
         }
-        SC_LOG(DEBUG, "send_command, layload_size=%d", length);
+        generatorParked = false;
 
-        while (m_transactionLayer->send_TLP(PCIeTLPType::MWr, payloads) != true) {
+        std::vector<PCIeTLPPayload> *payloads = next_write();
+        while (m_writeCombiner->write(sendAddress, payloads) != true) {
             wait(5, sc_core::SC_NS);
         }
-
-        // profiling
-        profile_write_byte_size += (length * 4);
-        
-        if (((i + 1) % 1000) == 0) {
-            sc_core::sc_time current_time = sc_core::sc_time_stamp();
-            sc_core::sc_time elapse_time = current_time - start_time;
-            // SC_LOG(INFO, "write dw size: %d Bytes", (int)profile_write_byte_size);
-            // SC_LOG(INFO, "elapse time: %d s", elapse_time.to_seconds());
-            SC_LOG(INFO, "write throughput: %.2f GB/s", ((profile_write_byte_size / (1024 * 1024)) / elapse_time.to_seconds()) );
+        if (RequesterFenceInterval != 0 && ((sendCount + 1) % RequesterFenceInterval) == 0) {
+            while (m_writeCombiner->fence() != true) {
+                wait(5, sc_core::SC_NS);
+            }
         }
-
-        delete(payloads);
-        
-        i++;
+        retire_write(payloads);
         // if (i >= 1000) {
         //     break;
         // }
     }
-}
\ No newline at end of file
+}
+
+std::vector<PCIeTLPPayload>* PCIeRequester_::next_write()
+{
+    // TLP restored from a checkpoint keeps its length and address
+    if (sendLength == 0) {
+        sendLength = rand.nextInt();
+        if (randAddress.nextInt() >= RequesterSequentialPercent) {
+            sendAddress = static_cast<uint64_t>(randAddress.nextInt(0, (RequesterAddressSpace / 4) - 1)) * 4;
+        }
+    }
+
+    std::vector<PCIeTLPPayload> *payloads = new std::vector<PCIeTLPPayload>();
+    for (uint32_t dw = 0; dw < sendLength; dw++) {
+        PCIeTLPPayload payload;
+        payload.payload = sendCount;
+        payloads->emplace_back(payload);
+    }
+    SC_LOG(DEBUG, "send_command, layload_size=%d", sendLength);
+    return payloads;
+}
+
+void PCIeRequester_::retire_write(std::vector<PCIeTLPPayload>* payloads)
+{
+    uint32_t length = payloads->size();
+
+    // profiling
+    profile_write_byte_size += (length * 4);
+    
+    if (((sendCount + 1) % 1000) == 0) {
+        sc_core::sc_time current_time = sc_core::sc_time_stamp();
+        sc_core::sc_time elapse_time = current_time - start_time;
+        // SC_LOG(INFO, "write dw size: %d Bytes", (int)profile_write_byte_size);
+        // SC_LOG(INFO, "elapse time: %d s", elapse_time.to_seconds());
+        SC_LOG(INFO, "write throughput: %.2f GB/s", ((profile_write_byte_size / (1024 * 1024)) / elapse_time.to_seconds()) );
+        m_transactionLayer->report_vc_stats();
+        m_writeCombiner->report_stats();
+        m_transactionLayer->report_pipeline_stats();
+        m_dataLinkLayer->report_pipeline_stats();
+        m_dataLinkLayer->report_aspm_stats();
+        PCIeInstrumentPolicy::report();
+    }
+
+    delete(payloads);
+    
+    sendAddress = (sendAddress + (length * 4)) % RequesterAddressSpace;
+    sendLength = 0;
+    sendCount++;
+}
+
+void PCIeRequester_::pause_generator()
+{
+    generatorPaused = true;
+}
+
+void PCIeRequester_::resume_generator()
+{
+    generatorPaused = false;
+    event_generatorResume.notify();
+}
+
+bool PCIeRequester_::drain()
+{
+    // a paused generator parks between writes, its open combine buffer goes out,
+    // then nothing may be queued or on the link
+    if (generatorPaused && !generatorParked) {
+        return false;
+    }
+    return m_writeCombiner->fence() && m_transactionLayer->tx_is_idle() && m_dataLinkLayer->link_is_idle();
+}
+
+void PCIeRequester_::fast_forward(sc_core::sc_time duration)
+{
+    // the writes the paused generator would have issued, a functional transaction layer never refuses them
+    uint64_t count = duration.value() / sc_core::sc_time(RequesterIssueInterval, SC_NS).value();
+    for (uint64_t i = 0; i < count; i++) {
+        std::vector<PCIeTLPPayload> *payloads = next_write();
+        if (m_writeCombiner->write(sendAddress, payloads) != true) {
+            SC_LOG(WARN, "fast-forward write refused, %d of %d issued", i, count);
+            delete(payloads);
+            return;
+        }
+        if (RequesterFenceInterval != 0 && ((sendCount + 1) % RequesterFenceInterval) == 0) {
+            m_writeCombiner->fence();
+        }
+        retire_write(payloads);
+    }
+    m_writeCombiner->fence();
+}
+
+sc_core::sc_time PCIeRequester_::receive_TLP(const PCIeTLPHeader& header, std::vector<PCIeTLPPayload>* payloads)
+{
+    PCIeTLPType type = static_cast<PCIeTLPType>(header.Type);
+    if (is_completion(type) && header.AT == PCIeATTranslationReq) {
+        m_atc->receive_translation(header, payloads);
+    }
+    else if (is_completion(type)) {
+        m_dmaEngine->receive_completion(header, payloads);
+    }
+    else if (type == PCIeTLPType::MsgD && payloads->at(0).payload == static_cast<uint32_t>(PCIeMsgCode::ATSInvalidateRequest)) {
+        m_atc->receive_invalidation(payloads);
+    }
+    else {
+        SC_LOG(WARN, "unhandled TLP type=%d", header.Type);
+    }
+    return SC_ZERO_TIME;
+}
+
+void PCIeRequester_::save(CheckpointWriter& writer)
+{
+    writer.section(name());
+    writer.put_string(rand.get_state());
+    writer.put(sendCount);
+    writer.put(sendLength);
+    writer.put(sendAddress);
+    writer.put_string(randAddress.get_state());
+    m_writeCombiner->save(writer);
+    m_transactionLayer->save(writer);
+    m_dataLinkLayer->save(writer);
+}
+
+bool PCIeRequester_::restore(CheckpointReader& reader)
+{
+    if (!reader.section(name())) {
+        return false;
+    }
+    rand.set_state(reader.get_string());
+    sendCount = reader.get<uint32_t>();
+    sendLength = reader.get<uint32_t>();
+    sendAddress = reader.get<uint64_t>();
+    randAddress.set_state(reader.get_string());
+    return m_writeCombiner->restore(reader) && m_transactionLayer->restore(reader) && m_dataLinkLayer->restore(reader);
+}
@@ -0,0 +1,87 @@
+#include "pcie_sampling.hpp"
+
+//  ==========================================
+//  PCIeSamplingController Function Definition
+//  ==========================================
+
+void PCIeSamplingController::set_functional(bool enable)
+{
+    m_requester->m_transactionLayer->set_functional(enable);
+    m_completer->m_transactionLayer->set_functional(enable);
+    m_requester->m_dataLinkLayer->set_functional(enable);
+    m_completer->m_dataLinkLayer->set_functional(enable);
+    m_completer->m_memory->set_functional(enable);
+}
+
+bool PCIeSamplingController::drain()
+{
+    // a functional TLP must not overtake one still queued or on the link, nor its data a timed write
+    return m_requester->drain() && m_completer->m_transactionLayer->tx_is_idle() && m_completer->m_dataLinkLayer->link_is_idle() && m_completer->writes_drained();
+}
+
+void PCIeSamplingController::fast_forward()
+{
+    // random traffic of the whole interval goes out at once, then one wait covers it;
+    // an interval that never finds the link drained stays detailed
+    sc_core::sc_time end = sc_time_stamp() + sc_core::sc_time(SamplingFastForward, SC_NS);
+    bool generator = (RequesterTrafficMode == RequesterTrafficRandom);
+    if (generator) {
+        m_requester->pause_generator();
+    }
+    while (!drain() && sc_time_stamp() < end) {
+        wait(SamplingDrainPoll, SC_NS);
+    }
+    if (sc_time_stamp() < end) {
+        set_functional(true);
+        if (generator) {
+            m_requester->fast_forward(end - sc_time_stamp());
+        }
+        wait(end - sc_time_stamp());
+    }
+    set_functional(false);
+    if (generator) {
+        m_requester->resume_generator();
+    }
+}
+
+PCIeSamplingController::Snapshot PCIeSamplingController::take_snapshot()
+{
+    Snapshot snapshot = {};
+    for (PCIeTransactionLayer *tl : {m_requester->m_transactionLayer, m_completer->m_transactionLayer}) {
+        for (const TL_virtualChannel& vc : tl->vcs) {
+            snapshot.tlp_count += vc.profile_tlp_count;
+            snapshot.byte_size += vc.profile_byte_size;
+            snapshot.latency += vc.profile_latency;
+        }
+    }
+    return snapshot;
+}
+
+void PCIeSamplingController::process_sample()
+{
+    if (!SamplingEnable) {
+        return;
+    }
+
+    sc_core::sc_time window = sc_core::sc_time(SamplingWindow, SC_NS);
+    while (true) {
+        fast_forward();
+        wait(SamplingWarmup, SC_NS);
+
+        Snapshot begin = take_snapshot();
+        wait(window);
+        Snapshot end = take_snapshot();
+
+        uint64_t tlp_count = end.tlp_count - begin.tlp_count;
+        throughput.add(((end.byte_size - begin.byte_size) / 1e9) / window.to_seconds());
+        if (tlp_count > 0) {
+            latency.add(((end.latency - begin.latency) / tlp_count) * 1e9);
+        }
+        SC_LOG(DEBUG, "sample %d: TLP: %d, throughput: %.3f GB/s", throughput.size(), tlp_count, ((end.byte_size - begin.byte_size) / 1e9) / window.to_seconds());
+
+        if ((throughput.size() % SamplingReportInterval) == 0) {
+            double detail = 100.0 * (SamplingWarmup + SamplingWindow) / (SamplingFastForward + SamplingWarmup + SamplingWindow);
+            SC_LOG(INFO, "sampled throughput: %.3f +- %.3f GB/s, latency: %.2f +- %.2f ns (n=%d, %.1f%% detailed)", throughput.mean(), throughput.interval(), latency.mean(), latency.interval(), throughput.size(), detail);
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#include "pcie_scoreboard.hpp"
+#include "pcie_layers.hpp"
+
+//  ==================================
+//  PCIeScoreboard Function Definition
+//  ==================================
+
+void PCIeScoreboard::connect(PCIeDataLinkLayer *a, PCIeDataLinkLayer *b)
+{
+    if (!ScoreboardEnable) {
+        return;
+    }
+    peer[a] = b;
+    peer[b] = a;
+    a->set_scoreboard(this);
+    b->set_scoreboard(this);
+}
+
+void PCIeScoreboard::expect(PCIeDataLinkLayer *sender, uint32_t seqNum, const PCIeTLPHeader& header, uint32_t length, uint64_t checksum)
+{
+    inflight[sender][seqNum] = {header, length, checksum, sc_core::sc_time_stamp()};
+}
+
+bool PCIeScoreboard::check(PCIeDataLinkLayer *receiver, uint32_t seqNum, const PCIeTLPHeader& header, const std::vector<PCIeTLPPayload>* payloads)
+{
+    auto& streams = inflight[peer[receiver]];
+    auto it = streams.find(seqNum);
+    uint32_t length = (payloads != nullptr) ? payloads->size() : 0;
+
+    PCIeChecksum checksum;
+    for (uint32_t i = 0; i < length; i++) {
+        checksum.add(payloads->at(i).payload);
+    }
+
+    profile_tlp_count++;
+    profile_dw_count += length;
+    if (it == streams.end()) {
+        report_mismatch("unexpected TLP", seqNum, Expected{header, 0, 0, SC_ZERO_TIME}, header, payloads, checksum.value());
+        return false;
+    }
+
+    Expected expected = it->second;
+    streams.erase(it);
+    if (expected.header.Type != header.Type || expected.header.tag != header.tag || get_tlp_address(expected.header) != get_tlp_address(header)) {
+        report_mismatch("header mismatch", seqNum, expected, header, payloads, checksum.value());
+        return false;
+    }
+    if (expected.length != length || expected.checksum != checksum.value()) {
+        report_mismatch("payload mismatch", seqNum, expected, header, payloads, checksum.value());
+        return false;
+    }
+    return true;
+}
+
+void PCIeScoreboard::report_mismatch(const char *reason, uint32_t seqNum, const Expected& expected, const PCIeTLPHeader& header, const std::vector<PCIeTLPPayload>* payloads, uint64_t checksum)
+{
+    profile_mismatch_count++;
+    if (profile_mismatch_count > 1) {
+        return;
+    }
+
+    uint32_t length = (payloads != nullptr) ? payloads->size() : 0;
+    SC_LOG(ERROR, "%s: seqNum=%d, checked TLP: %d", reason, seqNum, profile_tlp_count);
+    SC_LOG(ERROR, "received: type=%d, tag=%d, reqID=%d, TC=%d, attr=%d, address=0x%llx, Length=%d, payload DW=%d, checksum=0x%016llx", header.Type, header.tag, header.reqID, header.TC, get_tlp_attr(header), get_tlp_address(header), header.Length, length, checksum);
+    SC_LOG(ERROR, "expected: type=%d, tag=%d, reqID=%d, TC=%d, attr=%d, address=0x%llx, Length=%d, payload DW=%d, checksum=0x%016llx, sent at %.2f ns", expected.header.Type, expected.header.tag, expected.header.reqID, expected.header.TC, get_tlp_attr(expected.header), get_tlp_address(expected.header), expected.header.Length, expected.length, expected.checksum, expected.timestamp.to_seconds() * 1e9);
+    for (uint32_t i = 0; i < std::min<uint32_t>(length, ScoreboardDumpDW); i++) {
+        SC_LOG(ERROR, "received data[%d]: 0x%08x", i, payloads->at(i).payload);
+    }
+
+    if (ScoreboardStopOnMismatch) {
+        sc_core::sc_stop();
+    }
+}
+
+void PCIeScoreboard::report_stats()
+{
+    if (!ScoreboardEnable) {
+        return;
+    }
+    uint64_t inflight_count = 0;
+    for (const auto& streams : inflight) {
+        inflight_count += streams.second.size();
+    }
+    SC_LOG(INFO, "checked TLP: %d, DW: %d, mismatch: %d, in flight: %d", profile_tlp_count, profile_dw_count, profile_mismatch_count, inflight_count);
+}
@@ -0,0 +1,233 @@
+#include "pcie_sizing.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <limits>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+PCIeSizingResult pcie_simulate_forked(const std::function<PCIeSizingResult()>& simulate, const PCIeResourceConfig& config)
+{
+    PCIeSizingResult result = {0, std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity()};
+    int fd[2];
+    if (pipe(fd) != 0) {
+        return result;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        close(fd[0]);
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+
+        pcie_resource_config() = config;
+        PCIeSizingResult child = simulate();
+        ssize_t written = write(fd[1], &child, sizeof(child));
+        _exit(written == sizeof(child) ? 0 : 1);
+    }
+
+    close(fd[1]);
+    if (pid > 0) {
+        PCIeSizingResult child;
+        if (read(fd[0], &child, sizeof(child)) == sizeof(child)) {
+            result = child;
+        }
+        waitpid(pid, nullptr, 0);
+    }
+    close(fd[0]);
+    return result;
+}
+
+uint64_t pcie_resource_area(const PCIeResourceConfig& config)
+{
+    uint64_t internal_buffer = static_cast<uint64_t>(config.internalBufferSize) * 4;
+    uint64_t replay_buffer = static_cast<uint64_t>(config.replayBufferSize) * (PCIeTLPHeaderByte + 4);
+    uint64_t tag = static_cast<uint64_t>(config.tagCount) * SizingTagEntryByte;
+    uint64_t receive_buffer = static_cast<uint64_t>(config.credits) * (PCIeTLPHeaderByte + 4);
+    return internal_buffer + replay_buffer + tag + receive_buffer;
+}
+
+//  ====================================
+//  PCIeSizingSearch Function Definition
+//  ====================================
+
+static const char* sizing_resource_name[] = {"internal buffer", "replay buffer", "tag", "credit"};
+// a buffer keeps one DW free, so it needs MPS + 1 to hold a max size TLP
+static const uint32_t sizing_resource_min[] = {(PCIeMaxPayloadSize / 4) + 1, (PCIeMaxPayloadSize / 4) + 1, 1, PCIeCreditTypeCount * (PCIeMaxPayloadSize / 4)};
+
+// the smallest usable size, then power of two sizes up to the macro default
+static std::vector<uint32_t> sizing_ladder(uint32_t min, uint32_t max)
+{
+    std::vector<uint32_t> ladder = {min};
+    uint32_t size = 1;
+    while (size <= min) {
+        size *= 2;
+    }
+    for (; size < max; size *= 2) {
+        ladder.push_back(size);
+    }
+    if (max > min) {
+        ladder.push_back(max);
+    }
+    return ladder;
+}
+
+PCIeResourceConfig PCIeSizingSearch::run()
+{
+    load_cache();
+
+    PCIeResourceConfig defaults;
+    SizingKey key = {defaults.internalBufferSize, defaults.replayBufferSize, defaults.tagCount, defaults.credits};
+    if (!meets_target(evaluate(key))) {
+        SC_LOG(WARN, "default sizes miss the target of %.2f GB/s, p99 %.2f ns", target_throughput, target_latency);
+        return defaults;
+    }
+
+    // shrink one resource at a time while the others stay put, until a whole pass changes nothing
+    bool changed = true;
+    for (int pass = 0; changed && pass < SizingMaxPass; pass++) {
+        changed = false;
+        for (int r = 0; r < static_cast<int>(SizingResource::Count); r++) {
+            std::vector<uint32_t> ladder = sizing_ladder(sizing_resource_min[r], std::max(sizing_resource_min[r], key[r]));
+            size_t lo = 0;
+            size_t hi = ladder.size() - 1;
+            while (lo < hi) {
+                size_t mid = (lo + hi) / 2;
+                SizingKey probe = key;
+                probe[r] = ladder[mid];
+                if (meets_target(evaluate(probe))) {
+                    hi = mid;
+                }
+                else {
+                    lo = mid + 1;
+                }
+            }
+            if (ladder[hi] != key[r]) {
+                SC_LOG(INFO, "pass %d: %s %d -> %d", pass, sizing_resource_name[r], key[r], ladder[hi]);
+                key[r] = ladder[hi];
+                changed = true;
+            }
+        }
+    }
+
+    PCIeResourceConfig config = get_config(key);
+    SC_LOG(INFO, "smallest: internal buffer=%d DW, replay buffer=%d, tag=%d, credit=%d, area=%d B, simulated: %d, cached: %d", key[0], key[1], key[2], key[3], get_area(key), profile_run_count, profile_cache_hit);
+    return config;
+}
+
+PCIeSizingResult PCIeSizingSearch::evaluate(const SizingKey& key)
+{
+    auto it = results.find(key);
+    if (it != results.end()) {
+        profile_cache_hit++;
+        return it->second;
+    }
+
+    PCIeSizingResult result = pcie_simulate_forked(simulate, get_config(key));
+    results[key] = result;
+    save_cache(key, result);
+    profile_run_count++;
+    SC_LOG(INFO, "internal buffer=%d, replay buffer=%d, tag=%d, credit=%d: %.2f GB/s, p99 %.2f ns, area=%d B", key[0], key[1], key[2], key[3], result.throughput, result.p99_latency, get_area(key));
+    return result;
+}
+
+bool PCIeSizingSearch::meets_target(const PCIeSizingResult& result)
+{
+    return result.throughput >= target_throughput && result.p99_latency <= target_latency;
+}
+
+uint64_t PCIeSizingSearch::get_area(const SizingKey& key)
+{
+    return pcie_resource_area(get_config(key));
+}
+
+PCIeResourceConfig PCIeSizingSearch::get_config(const SizingKey& key)
+{
+    PCIeResourceConfig config;
+    config.internalBufferSize = key[0];
+    config.replayBufferSize = key[1];
+    config.tagCount = key[2];
+    config.credits = key[3];
+    return config;
+}
+
+void PCIeSizingSearch::report_frontier()
+{
+    // keep the points no other point beats on area, throughput and p99 at once
+    std::vector<std::pair<SizingKey, PCIeSizingResult>> frontier;
+    for (const auto& point : results) {
+        bool dominated = false;
+        for (const auto& other : results) {
+            bool no_worse = get_area(other.first) <= get_area(point.first) && other.second.throughput >= point.second.throughput && other.second.p99_latency <= point.second.p99_latency;
+            bool better = get_area(other.first) < get_area(point.first) || other.second.throughput > point.second.throughput || other.second.p99_latency < point.second.p99_latency;
+            if (no_worse && better) {
+                dominated = true;
+                break;
+            }
+        }
+        if (!dominated) {
+            frontier.push_back(point);
+        }
+    }
+    std::sort(frontier.begin(), frontier.end(), [this](const auto& a, const auto& b) { return get_area(a.first) < get_area(b.first); });
+
+    SC_LOG(INFO, "pareto frontier of %d points, workload %s", frontier.size(), workload.c_str());
+    for (const auto& point : frontier) {
+        const SizingKey& key = point.first;
+        SC_LOG(INFO, "area=%d B, %.2f GB/s, p99 %.2f ns: internal buffer=%d, replay buffer=%d, tag=%d, credit=%d%s", get_area(key), point.second.throughput, point.second.p99_latency, key[0], key[1], key[2], key[3], meets_target(point.second) ? " *" : "");
+    }
+}
+
+// every macro is compiled into the executable, so its FNV-1a hash names the build
+std::string PCIeSizingSearch::get_cache_path()
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    FILE *file = fopen("/proc/self/exe", "rb");
+    if (file != nullptr) {
+        unsigned char chunk[65536];
+        size_t length;
+        while ((length = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            for (size_t i = 0; i < length; i++) {
+                hash = (hash ^ chunk[i]) * 0x100000001b3ULL;
+            }
+        }
+        fclose(file);
+    }
+    char path[64];
+    snprintf(path, sizeof(path), SizingCachePrefix "%016llx.cache", static_cast<unsigned long long>(hash));
+    return path;
+}
+
+void PCIeSizingSearch::load_cache()
+{
+    cachePath = get_cache_path();
+    FILE *file = fopen(cachePath.c_str(), "r");
+    if (file == nullptr) {
+        return;
+    }
+
+    char name[128];
+    uint32_t run_time;
+    SizingKey key;
+    PCIeSizingResult result = {};
+    while (fscanf(file, "%127s %u %u %u %u %u %lf %lf", name, &run_time, &key[0], &key[1], &key[2], &key[3], &result.throughput, &result.p99_latency) == 8) {
+        if (workload == name && run_time == SizingRunTime) {
+            results[key] = result;
+        }
+    }
+    fclose(file);
+    SC_LOG(INFO, "%d cached points for workload %s in %s", results.size(), workload.c_str(), cachePath.c_str());
+}
+
+void PCIeSizingSearch::save_cache(const SizingKey& key, const PCIeSizingResult& result)
+{
+    FILE *file = fopen(cachePath.c_str(), "a");
+    if (file == nullptr) {
+        return;
+    }
+    fprintf(file, "%s %u %u %u %u %u %.6f %.6f\n", workload.c_str(), SizingRunTime, key[0], key[1], key[2], key[3], result.throughput, result.p99_latency);
+    fclose(file);
+}
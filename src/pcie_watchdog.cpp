@@ -0,0 +1,57 @@
+#include "pcie_watchdog.hpp"
+
+//  ================================
+//  PCIeWatchdog Function Definition
+//  ================================
+
+std::vector<PCIeWatchdog::LayerProgress> PCIeWatchdog::take_snapshot()
+{
+    return {
+        {"Requester transaction layer", m_requester->m_transactionLayer->get_progress(), m_requester->m_transactionLayer->has_pending_work()},
+        {"Requester data link layer", m_requester->m_dataLinkLayer->get_progress(), m_requester->m_dataLinkLayer->has_pending_work()},
+        {"Completer transaction layer", m_completer->m_transactionLayer->get_progress(), m_completer->m_transactionLayer->has_pending_work()},
+        {"Completer data link layer", m_completer->m_dataLinkLayer->get_progress(), m_completer->m_dataLinkLayer->has_pending_work()},
+    };
+}
+
+void PCIeWatchdog::process_watch()
+{
+    if (!WatchdogEnable) {
+        return;
+    }
+
+    std::vector<LayerProgress> last = take_snapshot();
+    while (true) {
+        wait(WatchdogWindow, SC_NS);
+
+        // stalled: pending at both ends of the window and not a single step in between
+        std::vector<LayerProgress> now = take_snapshot();
+        bool stalled = false;
+        for (size_t i = 0; i < now.size(); i++) {
+            if (last[i].pending && now[i].pending && last[i].progress == now[i].progress) {
+                SC_LOG(ERROR, "%s stalled for %d ns, progress=%d", now[i].name, WatchdogWindow, now[i].progress);
+                stalled = true;
+            }
+        }
+        last = now;
+        if (!stalled) {
+            continue;
+        }
+
+        dump_state();
+        if (WatchdogAction == WatchdogActionCheckpoint && m_checkpoint != nullptr) {
+            m_checkpoint->save(WatchdogCheckpointPath);
+        }
+        sc_core::sc_stop();
+        return;
+    }
+}
+
+void PCIeWatchdog::dump_state()
+{
+    SC_LOG(ERROR, "resource dump at %.2f ns", sc_core::sc_time_stamp().to_seconds() * 1e9);
+    m_requester->m_transactionLayer->dump_state();
+    m_requester->m_dataLinkLayer->dump_state();
+    m_completer->m_transactionLayer->dump_state();
+    m_completer->m_dataLinkLayer->dump_state();
+}
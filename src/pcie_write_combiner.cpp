@@ -0,0 +1,170 @@
+#include "pcie_write_combiner.hpp"
+
+//  =====================================
+//  PCIeWriteCombiner Function Definition
+//  =====================================
+
+bool PCIeWriteCombiner::write(uint64_t address, std::vector<PCIeTLPPayload>* payloads)
+{
+    if (!WriteCombineEnable) {
+        // the tail of an earlier split write goes first, nothing overtakes it
+        if (!buffer.empty() && !flush(WriteCombineFlush::Boundary)) {
+            return false;
+        }
+
+        // a write crossing a page sends its head now, the tail is held like an open buffer;
+        // a refused head leaves nothing sent, so the caller retries the whole write
+        uint64_t last = address + (payloads->size() * 4) - 1;
+        size_t head = payloads->size();
+        if ((address / PCIeBoundarySize) != (last / PCIeBoundarySize)) {
+            head = (PCIeBoundarySize - (address % PCIeBoundarySize)) / 4;
+        }
+        std::vector<PCIeTLPPayload> head_payloads(payloads->begin(), payloads->begin() + head);
+        if (!m_transactionLayer->send_TLP(PCIeTLPType::MWr, &head_payloads, address)) {
+            return false;
+        }
+        profile_write_count++;
+        profile_tlp_count++;
+        profile_byte_size += head * 4;
+
+        if (head < payloads->size()) {
+            buffer.assign(payloads->begin() + head, payloads->end());
+            baseAddress = address + (head * 4);
+            openTime = sc_core::sc_time_stamp();
+            event_open.notify();
+            SC_LOG(VERB, "pass-through: address=0x%llx, length=%d, split at page", address, payloads->size());
+
+            // a refused flush is retried by the timeout
+            flush(WriteCombineFlush::Boundary);
+        }
+        return true;
+    }
+
+    // the open buffer leaves first when the write does not follow on, would overflow MPS or leave its page
+    if (!buffer.empty()) {
+        bool contiguous = address == (baseAddress + (buffer.size() * 4));
+        if (!contiguous && !flush(WriteCombineFlush::Discontiguous)) {
+            return false;
+        }
+        if (contiguous && (baseAddress / PCIeBoundarySize) != (address / PCIeBoundarySize) && !flush(WriteCombineFlush::Boundary)) {
+            return false;
+        }
+        if (contiguous && (buffer.size() + payloads->size()) > (PCIeMaxPayloadSize / 4) && !flush(WriteCombineFlush::Full)) {
+            return false;
+        }
+    }
+
+    // a write crossing a page sends its head with the buffer, the rest opens the next page
+    uint64_t last = address + (payloads->size() * 4) - 1;
+    if ((address / PCIeBoundarySize) != (last / PCIeBoundarySize)) {
+        size_t head = (PCIeBoundarySize - (address % PCIeBoundarySize)) / 4;
+        if (buffer.empty()) {
+            baseAddress = address;
+        }
+        buffer.insert(buffer.end(), payloads->begin(), payloads->begin() + head);
+        if (!flush(WriteCombineFlush::Boundary)) {
+            buffer.resize(buffer.size() - head);
+            return false;
+        }
+        address += head * 4;
+        buffer.insert(buffer.end(), payloads->begin() + head, payloads->end());
+        baseAddress = address;
+        openTime = sc_core::sc_time_stamp();
+        event_open.notify();
+        profile_write_count++;
+        SC_LOG(VERB, "combine: address=0x%llx, length=%d, split at page, buffered=%d", address, payloads->size(), buffer.size());
+        return true;
+    }
+
+    if (buffer.empty()) {
+        baseAddress = address;
+        openTime = sc_core::sc_time_stamp();
+        event_open.notify();
+    }
+    buffer.insert(buffer.end(), payloads->begin(), payloads->end());
+    profile_write_count++;
+    SC_LOG(VERB, "combine: address=0x%llx, length=%d, buffered=%d", address, payloads->size(), buffer.size());
+
+    // nothing more fits, no reason to wait; a refused flush is retried by the timeout
+    if (buffer.size() == (PCIeMaxPayloadSize / 4)) {
+        flush(WriteCombineFlush::Full);
+    }
+    return true;
+}
+
+bool PCIeWriteCombiner::fence()
+{
+    return buffer.empty() || flush(WriteCombineFlush::Fence);
+}
+
+bool PCIeWriteCombiner::flush(WriteCombineFlush reason)
+{
+    if (!m_transactionLayer->send_TLP(PCIeTLPType::MWr, &buffer, baseAddress)) {
+        return false;
+    }
+    SC_LOG(DEBUG, "flush: address=0x%llx, length=%d, reason=%d", baseAddress, buffer.size(), static_cast<int>(reason));
+
+    // profiling
+    profile_tlp_count++;
+    profile_byte_size += buffer.size() * 4;
+    profile_flush_count[static_cast<int>(reason)]++;
+
+    buffer.clear();
+    return true;
+}
+
+void PCIeWriteCombiner::process_timeout()
+{
+    while (true) {
+        if (buffer.empty()) {
+            wait(event_open);
+            continue;
+        }
+
+        sc_core::sc_time deadline = openTime + sc_core::sc_time(WriteCombineTimeout, SC_NS);
+        if (sc_core::sc_time_stamp() < deadline) {
+            wait(deadline - sc_core::sc_time_stamp(), event_open);
+            continue;
+        }
+        if (!flush(WriteCombineFlush::Timeout)) {
+            wait(5, sc_core::SC_NS);
+        }
+    }
+}
+
+void PCIeWriteCombiner::report_stats()
+{
+    if (profile_tlp_count == 0) {
+        return;
+    }
+
+    // link efficiency with one TLP per write against the combined TLPs;
+    // page splits can send more TLPs than writes, the saving goes negative then
+    double overhead_saved = (static_cast<double>(profile_write_count) - static_cast<double>(profile_tlp_count)) * PCIeTLPOverheadByte;
+    double efficiency_write = profile_byte_size / (profile_byte_size + (profile_write_count * PCIeTLPOverheadByte));
+    double efficiency_tlp = profile_byte_size / (profile_byte_size + (profile_tlp_count * PCIeTLPOverheadByte));
+    SC_LOG(INFO, "write combine: write: %d, TLP: %d, avg TLP: %.2f B, header overhead saved: %.2f KB, link efficiency: %.2f%% -> %.2f%%", profile_write_count, profile_tlp_count, profile_byte_size / profile_tlp_count, overhead_saved / 1024, efficiency_write * 100, efficiency_tlp * 100);
+    SC_LOG(INFO, "write combine flush: full: %d, discontiguous: %d, boundary: %d, timeout: %d, fence: %d", profile_flush_count[0], profile_flush_count[1], profile_flush_count[2], profile_flush_count[3], profile_flush_count[4]);
+}
+
+void PCIeWriteCombiner::save(CheckpointWriter& writer)
+{
+    writer.section(name());
+    writer.put(baseAddress);
+    writer.put_vector(buffer);
+    writer.put_time(openTime);
+}
+
+bool PCIeWriteCombiner::restore(CheckpointReader& reader)
+{
+    if (!reader.section(name())) {
+        return false;
+    }
+    baseAddress = reader.get<uint64_t>();
+    reader.get_vector(buffer);
+    openTime = reader.get_time();
+    if (!buffer.empty()) {
+        event_open.notify(SC_ZERO_TIME);
+    }
+    return reader.good();
+}
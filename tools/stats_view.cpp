@@ -0,0 +1,119 @@
+// live statistics viewer, attaches to the shared memory segment of a running simulation
+//   usage: ./_stats_view [pid]
+//   without pid the first live segment in /dev/shm is used, segments of exited runs are removed
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "pcie_stats_shm.hpp"
+
+#define ViewRefreshPeriod     500     // ms
+
+static bool process_alive(long pid)
+{
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+static long find_simulation()
+{
+    std::string prefix = std::string(LiveStatsShmPrefix).substr(1);
+    DIR *dir = opendir("/dev/shm");
+    if (dir == nullptr) {
+        return -1;
+    }
+    long found = -1;
+    while (struct dirent *entry = readdir(dir)) {
+        if (std::strncmp(entry->d_name, prefix.c_str(), prefix.size()) != 0) {
+            continue;
+        }
+        long pid = std::atol(entry->d_name + prefix.size());
+        if (process_alive(pid)) {
+            found = pid;
+            break;
+        }
+        shm_unlink((std::string("/") + entry->d_name).c_str());
+    }
+    closedir(dir);
+    return found;
+}
+
+static double percent(uint32_t used, uint32_t size)
+{
+    return (size > 0) ? (100.0 * used) / size : 0;
+}
+
+static void show(const PCIeLiveStatsData& data, long pid, bool alive)
+{
+    static const char *type_name[3] = {"P", "NP", "Cpl"};
+    double rate = (data.wall_time > 0) ? (data.sim_time / 1e3) / data.wall_time : 0;
+
+    std::printf("\033[H\033[2J");
+    std::printf("PCIe simulation %ld %s\n\n", pid, data.done ? "(finished)" : (alive ? "" : "(exited)"));
+    std::printf("  sim time       %14.0f ns\n", data.sim_time);
+    std::printf("  wall time      %14.2f s\n", data.wall_time);
+    std::printf("  sim / wall     %14.2f us/s\n", rate);
+    std::printf("  throughput     %14.3f GB/s\n", data.throughput);
+    std::printf("  progress       %14llu TLP\n", static_cast<unsigned long long>(data.progress));
+    std::printf("  unacked        %14u TLP\n", data.unacked);
+    std::printf("  outstanding NP %14u\n\n", data.outstanding_np);
+    std::printf("  credits (vc0)       header  payload\n");
+    for (int type = 0; type < 3; type++) {
+        std::printf("    %-4s          %8u %8u\n", type_name[type], data.credit_header[type], data.credit_payload[type]);
+    }
+    std::printf("\n  replay buffer  header %6.1f%%, payload %6.1f%% of %u\n",
+                percent(data.replay_header_used, data.replay_size), percent(data.replay_payload_used, data.replay_size), data.replay_size);
+    std::printf("  internal buffer       %6.1f%% of %u DW\n", percent(data.internal_used, data.internal_size), data.internal_size);
+    std::fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+    long pid = (argc > 1) ? std::atol(argv[1]) : find_simulation();
+    if (pid <= 0) {
+        std::fprintf(stderr, "no running simulation found in /dev/shm\n");
+        return 1;
+    }
+
+    std::string name = LiveStatsShmPrefix + std::to_string(pid);
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        std::fprintf(stderr, "cannot open %s\n", name.c_str());
+        return 1;
+    }
+    void *addr = mmap(nullptr, sizeof(PCIeLiveStatsShm), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        std::fprintf(stderr, "cannot map %s\n", name.c_str());
+        return 1;
+    }
+    const PCIeLiveStatsShm *shm = static_cast<const PCIeLiveStatsShm*>(addr);
+    if (shm->magic != LiveStatsMagic || shm->version != LiveStatsVersion) {
+        std::fprintf(stderr, "%s: unknown layout\n", name.c_str());
+        return 1;
+    }
+
+    PCIeLiveStatsData data;
+    std::memset(&data, 0, sizeof(data));
+    while (true) {
+        // a torn read is dropped, the last good snapshot stays on screen
+        bool fresh = shm->snapshot(data);
+        bool alive = process_alive(pid);
+        if (fresh) {
+            show(data, pid, alive);
+        }
+        if ((fresh && data.done) || !alive) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(ViewRefreshPeriod));
+    }
+    munmap(addr, sizeof(PCIeLiveStatsShm));
+    return 0;
+}